@@ -0,0 +1,42 @@
+#!/bin/bash
+
+# Builds libsim_engine.a (the shared simulator engine) and every executable into executables/
+# Usage: ./build.sh [max distance, default 20]
+# SIMD=avx2 or SIMD=avx512 builds the vector expectation kernel (see cpp_files/expectation_kernel.hpp); the default
+# scalar kernel gives bit-identical results on every machine
+
+CXX=${CXX:-g++}
+CXXFLAGS="-std=c++17 -O2 -pthread"
+
+if [ "$#" -gt 1 ]; then
+    echo "Usage: $0 [max_distance]"
+    exit 1
+fi
+if [ "$#" -eq 1 ]; then
+    CXXFLAGS="$CXXFLAGS -DMAX_DISTANCE=$1"
+fi
+
+case "$SIMD" in
+    "") ;;
+    avx2) CXXFLAGS="$CXXFLAGS -mavx2" ;;
+    avx512) CXXFLAGS="$CXXFLAGS -mavx512f" ;;
+    *) echo "Unknown SIMD: $SIMD (avx2 or avx512)"; exit 1 ;;
+esac
+
+set -e
+mkdir -p executables
+
+# Shared engine: loaders, field goal tables and CSV output (the templates live in sim_engine.hpp)
+$CXX $CXXFLAGS -c cpp_files/sim_engine.cpp -o executables/sim_engine.o
+ar rcs executables/libsim_engine.a executables/sim_engine.o
+rm executables/sim_engine.o
+
+for sim in simulator simulator_naive simulator_norm simulator_naive_norm simulator_mc ep_server pbp_scorer pbp_ingest; do
+    echo "Building $sim.out"
+    $CXX $CXXFLAGS cpp_files/$sim.cpp -Lexecutables -lsim_engine -o executables/$sim.out
+done
+
+for tool in cdf_pack cdf_build; do
+    echo "Building $tool.out"
+    $CXX $CXXFLAGS cpp_files/$tool.cpp -o executables/$tool.out
+done
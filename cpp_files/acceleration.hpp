@@ -0,0 +1,144 @@
+#ifndef ACCELERATION_HPP
+#define ACCELERATION_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <string>
+#include <vector>
+
+// Acceleration for the epoch loop's outer fixed point x = G(x), where x is the EP table an epoch starts from and
+// G(x) the table it produces (the prior, the first-and-10 rows, follows the table):
+//   plain      x <- G(x), which moves information about one possession per epoch
+//   SOR        x <- x + omega * (G(x) - x); omega > 1 carries each step further along its direction
+//   Anderson   x <- G(x) less the mix of the last `depth` steps that best cancels the residual G(x) - x
+// Accelerating the whole table rather than just the prior keeps G a function of x alone: the sweeps also start
+// from the previous table, and simulator_norm breaks cycles with it
+class FixedPointAcceleration {
+public:
+    void use_sor(double relaxation) {
+        omega = relaxation;
+        depth = 0;
+    }
+
+    void use_anderson(int history) {
+        depth = std::max(history, 1);
+        omega = 1.0;
+    }
+
+    // For log lines; to_string rounds omega to 6 decimals, so cache keys take relaxation() and history() instead
+    std::string name() const {
+        if (depth > 0) return "Anderson mixing, depth " + std::to_string(depth);
+        if (omega != 1.0) return "over-relaxation, omega " + std::to_string(omega);
+        return "none";
+    }
+
+    double relaxation() const { return omega; }   // 1 unless --sor
+    int history() const { return depth; }         // 0 unless --anderson
+
+    // x is the table the epoch started from, gx the table it produced; gx is replaced by the next epoch's start
+    // Returns false if gx was left as it is (plain iteration, or no usable history yet)
+    bool next(const std::vector<double>& x, std::vector<double>& gx) {
+        if (depth == 0 && omega == 1.0) return false;
+        size_t n = x.size();
+        std::vector<double> f(n);
+        for (size_t i = 0; i < n; i++) f[i] = gx[i] - x[i];
+
+        if (depth == 0) {
+            for (size_t i = 0; i < n; i++) gx[i] = x[i] + omega * f[i];
+            return true;
+        }
+
+        // History of differences between consecutive residuals and images
+        if (!last_f.empty()) {
+            std::vector<double> df(n), dg(n);
+            for (size_t i = 0; i < n; i++) {
+                df[i] = f[i] - last_f[i];
+                dg[i] = gx[i] - last_g[i];
+            }
+            delta_f.push_back(df);
+            delta_g.push_back(dg);
+            if ((int)delta_f.size() > depth) {
+                delta_f.pop_front();
+                delta_g.pop_front();
+            }
+        }
+        last_f = f;
+        last_g = gx;
+
+        std::vector<double> gamma;
+        if (delta_f.empty() || !least_squares(f, gamma)) return false;  // plain step
+
+        std::vector<double> mixed = gx;
+        for (size_t j = 0; j < gamma.size(); j++) {
+            for (size_t i = 0; i < n; i++) mixed[i] -= gamma[j] * delta_g[j][i];
+        }
+        for (size_t i = 0; i < n; i++) {
+            if (!std::isfinite(mixed[i])) {
+                restart();
+                return false;
+            }
+        }
+        gx = mixed;
+        return true;
+    }
+
+    void restart() {
+        delta_f.clear();
+        delta_g.clear();
+        last_f.clear();
+        last_g.clear();
+    }
+
+private:
+    double omega = 1.0;
+    int depth = 0;
+    std::deque<std::vector<double>> delta_f;
+    std::deque<std::vector<double>> delta_g;
+    std::vector<double> last_f;
+    std::vector<double> last_g;
+
+    // gamma minimizing |f - sum gamma[j] * delta_f[j]|, from the normal equations with a little ridge so nearly
+    // parallel steps stay solvable; false if they are singular anyway
+    bool least_squares(const std::vector<double>& f, std::vector<double>& gamma) const {
+        size_t m = delta_f.size();
+        std::vector<std::vector<double>> a(m, std::vector<double>(m + 1, 0.0));
+        double scale = 0.0;
+        for (size_t j = 0; j < m; j++) {
+            for (size_t k = 0; k < m; k++) a[j][k] = dot(delta_f[j], delta_f[k]);
+            a[j][m] = dot(delta_f[j], f);
+            scale = std::max(scale, a[j][j]);
+        }
+        if (scale == 0.0) return false;
+        for (size_t j = 0; j < m; j++) a[j][j] += 1e-10 * scale;
+
+        // Gaussian elimination with partial pivoting
+        for (size_t col = 0; col < m; col++) {
+            size_t pivot = col;
+            for (size_t row = col + 1; row < m; row++) {
+                if (std::abs(a[row][col]) > std::abs(a[pivot][col])) pivot = row;
+            }
+            if (std::abs(a[pivot][col]) < 1e-300) return false;
+            std::swap(a[col], a[pivot]);
+            for (size_t row = col + 1; row < m; row++) {
+                double factor = a[row][col] / a[col][col];
+                for (size_t k = col; k <= m; k++) a[row][k] -= factor * a[col][k];
+            }
+        }
+        gamma.assign(m, 0.0);
+        for (size_t col = m; col-- > 0;) {
+            double sum = a[col][m];
+            for (size_t k = col + 1; k < m; k++) sum -= a[col][k] * gamma[k];
+            gamma[col] = sum / a[col][col];
+        }
+        return true;
+    }
+
+    static double dot(const std::vector<double>& a, const std::vector<double>& b) {
+        double sum = 0.0;
+        for (size_t i = 0; i < a.size(); i++) sum += a[i] * b[i];
+        return sum;
+    }
+};
+
+#endif
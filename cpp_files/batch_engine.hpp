@@ -0,0 +1,347 @@
+#ifndef BATCH_ENGINE_HPP
+#define BATCH_ENGINE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "sim_engine.hpp"
+
+// Many scoring scenarios solved in one pass (simulator --scenarios): simulator's model (PropagatedPrior, MaxPlay,
+// in-place sweeps in sweep order) run on K parameter sets at once. The CDFs are compiled once into the same
+// transition table the Engine uses, and the EPs are laid out [lookup slot][scenario], so each outcome's mass and
+// successor are read once and applied to all K lanes in a contiguous inner loop, in fixed blocks of LANE_BLOCK
+// lanes the compiler turns into vector code (lanes never mix, so that changes no results). Each lane adds its outcomes in
+// the same order as a single run, and stops at the epoch a single run would stop at, so its table is
+// bit-identical to a simulator run built with that scenario's constants
+
+// One parameter set: the scoring values and a scale on the field goal make probabilities (kicker accuracy),
+// capped at 1. Kickoffs keep their conventions (safety kick from 70, touchback at 80), which fix where the
+// transitions lead
+struct Scenario {
+    std::string name;
+    double td_val = TD_VAL;
+    double fg_val = FG_VAL;
+    double ko_val = KO_VAL;
+    double fg_scale = 1;
+
+    Scoring scoring() const {
+        Scoring scoring{td_val, fg_val, ko_val, fg_prob};
+        for (double& make : scoring.field_goals) make = std::min(1.0, make * fg_scale);
+        return scoring;
+    }
+};
+
+// Reads a scenario CSV: a header naming the columns (name, then any of td_val, fg_val, ko_val, fg_scale in any
+// order; a missing column keeps the default), then one scenario per line. Names go into output file names, so
+// they must be unique and use only letters, digits, '-', '_' and '.'
+inline bool loadScenarios(const std::string& filename, std::vector<Scenario>& scenarios) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return false;
+    }
+
+    auto split = [](const std::string& line) {
+        std::vector<std::string> fields;
+        std::stringstream ss(line);
+        std::string field;
+        while (std::getline(ss, field, ',')) {
+            if (!field.empty() && field.back() == '\r') field.pop_back();
+            fields.push_back(field);
+        }
+        return fields;
+    };
+
+    std::string line;
+    std::getline(file, line);
+    std::vector<std::string> columns = split(line);
+    const std::vector<std::string> known = {"name", "td_val", "fg_val", "ko_val", "fg_scale"};
+    for (const std::string& column : columns) {
+        if (std::find(known.begin(), known.end(), column) == known.end()) {
+            std::cerr << "Unknown scenario column " << column << " in " << filename << std::endl;
+            return false;
+        }
+    }
+    if (std::find(columns.begin(), columns.end(), "name") == columns.end()) {
+        std::cerr << "Scenario file " << filename << " has no name column" << std::endl;
+        return false;
+    }
+
+    scenarios.clear();
+    int line_number = 1;
+    while (std::getline(file, line)) {
+        line_number++;
+        std::vector<std::string> fields = split(line);
+        if (fields.empty() || (fields.size() == 1 && fields[0].empty())) continue;
+        if (fields.size() != columns.size()) {
+            std::cerr << "Line " << line_number << " of " << filename << " has " << fields.size() << " fields, expected "
+                      << columns.size() << std::endl;
+            return false;
+        }
+
+        Scenario scenario;
+        try {
+            for (size_t c = 0; c < columns.size(); c++) {
+                if (columns[c] == "name") scenario.name = fields[c];
+                else if (columns[c] == "td_val") scenario.td_val = std::stod(fields[c]);
+                else if (columns[c] == "fg_val") scenario.fg_val = std::stod(fields[c]);
+                else if (columns[c] == "ko_val") scenario.ko_val = std::stod(fields[c]);
+                else scenario.fg_scale = std::stod(fields[c]);
+            }
+        }
+        catch (const std::exception&) {
+            std::cerr << "Bad number on line " << line_number << " of " << filename << std::endl;
+            return false;
+        }
+
+        bool safe_name = !scenario.name.empty() && std::all_of(scenario.name.begin(), scenario.name.end(), [](char c) {
+            return std::isalnum((unsigned char)c) || c == '-' || c == '_' || c == '.';
+        });
+        if (!safe_name) {
+            std::cerr << "Bad scenario name \"" << scenario.name << "\" on line " << line_number << " of " << filename << std::endl;
+            return false;
+        }
+        for (const Scenario& other : scenarios) {
+            if (other.name == scenario.name) {
+                std::cerr << "Scenario " << scenario.name << " appears twice in " << filename << std::endl;
+                return false;
+            }
+        }
+        if (!(scenario.fg_scale >= 0)) {
+            std::cerr << "Scenario " << scenario.name << " has a negative fg_scale" << std::endl;
+            return false;
+        }
+        scenarios.push_back(scenario);
+    }
+    if (scenarios.empty()) {
+        std::cerr << "No scenarios in " << filename << std::endl;
+        return false;
+    }
+
+    std::cout << "Loaded " << scenarios.size() << " scenarios from " << filename << std::endl;
+    return true;
+}
+
+// Lanes per inner block; the lane count is padded up to a multiple with idle lanes
+const int LANE_BLOCK = 8;
+
+class BatchEngine {
+public:
+    std::vector<PropagatedPrior> priors;   // one per scenario
+    std::vector<StateTable> tables;        // one per scenario, filled once the run ends
+
+    // Every lane starts from base (prior EPs and punt profiles) with its scenario's scoring
+    BatchEngine(CDFStore& cdf_store, std::vector<int>& yardline_mapping, const PropagatedPrior& base,
+                const std::vector<Scenario>& scenarios)
+        : tables(scenarios.size()), num_scenarios(scenarios.size()), cdf_store(cdf_store),
+          yardline_mapping(yardline_mapping), order(sweep_order()) {
+        for (const Scenario& scenario : scenarios) {
+            priors.push_back(base);
+            priors.back().scoring = scenario.scoring();
+        }
+        do {
+            priors.push_back(base);
+        } while (priors.size() % LANE_BLOCK != 0);
+        lanes = priors.size();
+    }
+
+    // Runs epochs until every lane converges (or max_epochs); each lane stops on its own. Returns the epoch each
+    // lane converged at, 0 if it did not within max_epochs, -1 if its EPs blew up
+    std::vector<int> run(ThreadPool& pool, double tolerance, int max_epochs, Progress& progress) {
+        if (mass.empty()) compile();
+        size_t width = (size_t)NUM_STATES * lanes;
+        lookup.assign((size_t)LOOKUP_SIZE * lanes, 0.0);
+        for (std::vector<double>* column : {&run_ep, &pass_ep, &kick_ep, &punt_ep}) column->assign(width, 0.0);
+        opt.assign(width, 0);
+        active.assign(lanes, 0);
+        std::fill(active.begin(), active.begin() + num_scenarios, 1);
+        blew_up.assign(lanes, 0);
+        std::vector<int> finished(lanes, 0);
+        std::vector<double> start_max;
+
+        for (int epoch = 1; epoch <= max_epochs; epoch++) {
+            if (std::count(active.begin(), active.end(), 1) == 0) break;
+            for (int k = 0; k < lanes; k++) {
+                if (!active[k]) continue;
+                priors[k].begin_epoch();
+                for (int yardline = 1; yardline < 100; yardline++) {
+                    lookup[(size_t)(LOOKUP_OPPONENT + yardline - 1) * lanes + k] = -priors[k].ep(yardline);
+                }
+            }
+            start_max.assign(lookup.begin(), lookup.begin() + width);
+
+            pool.parallel_for(lanes / LANE_BLOCK, [&](int begin, int end) { sweep(begin * LANE_BLOCK, end * LANE_BLOCK); });
+
+            // The same residuals as simulator's epochs: the largest change in the prior and in any EP
+            std::vector<double> change(lanes, 0.0);
+            for (int k = 0; k < lanes; k++) {
+                if (!active[k]) continue;
+                for (int yardline = 1; yardline < 100; yardline++) {
+                    double ep = lookup[(size_t)prior_state(yardline) * lanes + k];
+                    change[k] = std::max(change[k], std::abs(ep - priors[k].prior_epas[yardline-1]));
+                    priors[k].prior_epas[yardline-1] = ep;
+                }
+            }
+            for (size_t i = 0; i < width; i++) {
+                int k = i % lanes;
+                change[k] = std::max(change[k], std::abs(lookup[i] - start_max[i]));
+            }
+            for (int k = 0; k < lanes; k++) {
+                if (blew_up[k] && finished[k] == 0) finished[k] = -1;
+                if (active[k] && change[k] < tolerance) {
+                    finished[k] = epoch;
+                    active[k] = 0;
+                }
+            }
+            progress.report("Epoch", epoch, max_epochs);
+        }
+
+        for (int k = 0; k < num_scenarios; k++) {
+            for (const auto& [down, yards_to_go, yardline] : order) {
+                size_t i = (size_t)state_index(down, yards_to_go, yardline) * lanes + k;
+                tables[k].set(i / lanes, run_ep[i], pass_ep[i], kick_ep[i], punt_ep[i], lookup[i], opt[i]);
+            }
+        }
+        finished.resize(num_scenarios);
+        return finished;
+    }
+
+private:
+    // Constants a compiled outcome adds, per lane: the two touchdowns, then the fixed values (0, the safety's -2)
+    enum { TOUCHDOWN, TOUCHDOWN_AGAINST, FIRST_FIXED };
+
+    int num_scenarios;
+    int lanes;   // num_scenarios padded up to whole blocks
+    CDFStore& cdf_store;
+    std::vector<int>& yardline_mapping;
+    std::vector<std::array<int, 3>> order;
+
+    // The Engine's compiled outcomes, with each constant replaced by a class whose value comes per lane
+    std::vector<double> mass;
+    std::vector<uint8_t> constant_class;
+    std::vector<int32_t> gather;
+    std::vector<uint32_t> start;
+    std::vector<double> constants;   // [class][lane]
+
+    // Every lane's EPs, [lookup slot][lane] (see expectation_kernel.hpp); the state rows are each lane's best play
+    // EP, updated in place as the sweep goes
+    std::vector<double> lookup;
+    std::vector<double> run_ep, pass_ep, kick_ep, punt_ep;   // [state][lane]
+    std::vector<int> opt;                                    // [state][lane]
+    std::vector<char> active;        // lane still running epochs
+    std::vector<char> blew_up;       // lane stopped on runaway EPs
+
+    struct ClassSink {
+        std::vector<double>& fixed;
+        int constant_class;
+        int32_t gather;
+        void fixed_class(double value) {
+            size_t c = std::find(fixed.begin(), fixed.end(), value) - fixed.begin();
+            if (c == fixed.size()) fixed.push_back(value);
+            constant_class = FIRST_FIXED + c;
+        }
+        double points(double value) { fixed_class(value); gather = LOOKUP_ZERO; return 0; }
+        double touchdown() { constant_class = TOUCHDOWN; gather = LOOKUP_ZERO; return 0; }
+        double touchdown_against() { constant_class = TOUCHDOWN_AGAINST; gather = LOOKUP_ZERO; return 0; }
+        double opponent(int yardline) { fixed_class(0.0); gather = LOOKUP_OPPONENT + yardline - 1; return 0; }
+        double opponent_after(double value, int yardline) {
+            fixed_class(value);
+            gather = LOOKUP_OPPONENT + yardline - 1;
+            return 0;
+        }
+        double state(int index) { fixed_class(0.0); gather = index; return 0; }
+    };
+
+    // Same walk as Engine::compile_outcomes; where a result goes does not depend on the scoring, so any lane's
+    // prior decodes it
+    void compile() {
+        std::vector<double> fixed;
+        ClassSink sink{fixed, 0, 0};
+        start.assign(2 * NUM_STATES + 1, 0);
+        for (int index = 0; index < NUM_STATES; index++) {
+            int yardline = index % NUM_YARDLINES + 1;
+            int yards_to_go = (index / NUM_YARDLINES) % MAX_DISTANCE + 1;
+            int down = index / (NUM_YARDLINES * MAX_DISTANCE) + 1;
+            for (int play = 0; play < 2; play++) {
+                start[2*index + play] = mass.size();
+                if (yards_to_go > yardline) continue;  // not a state
+                CDFView cdf = cdf_store.find(play, yardline_mapping[yardline], down, yards_to_go);
+                double prev = 0.0;
+                for (uint32_t i = 0; i < cdf.size; i++) {
+                    play_result(priors[0], cdf.outcomes[i], down, yards_to_go, yardline, sink);
+                    mass.push_back(cdf.cdf[i]-prev);
+                    constant_class.push_back(sink.constant_class);
+                    gather.push_back(sink.gather);
+                    prev = cdf.cdf[i];
+                }
+            }
+        }
+        start[2 * NUM_STATES] = mass.size();
+
+        constants.assign((FIRST_FIXED + fixed.size()) * lanes, 0.0);
+        for (int k = 0; k < lanes; k++) {
+            constants[TOUCHDOWN * lanes + k] = priors[k].scoring.touchdown();
+            constants[TOUCHDOWN_AGAINST * lanes + k] = -priors[k].scoring.td_val;
+            for (size_t c = 0; c < fixed.size(); c++) constants[(FIRST_FIXED + c) * lanes + k] = fixed[c];
+        }
+    }
+
+    // sum += m * (constant + ep) over one block of lanes
+    static void accumulate(double* __restrict__ sum, double m, const double* __restrict__ constant,
+                           const double* __restrict__ ep) {
+        for (int k = 0; k < LANE_BLOCK; k++) sum[k] += m * (constant[k] + ep[k]);
+    }
+
+    // One in-place sweep in sweep order over lanes [begin, end), whole blocks: each outcome is applied to every lane,
+    // then each running lane picks its best play and writes its new EP back for the states after it
+    void sweep(int begin, int end) {
+        int width = end - begin;
+        std::vector<double> epa_vals[2] = {std::vector<double>(width), std::vector<double>(width)};  // rush, pass
+        for (const auto& [down, yards_to_go, yardline] : order) {
+            int index = state_index(down, yards_to_go, yardline);
+            for (int play = 0; play < 2; play++) {
+                double* sum = epa_vals[play].data();
+                std::fill(sum, sum + width, 0.0);
+                for (uint32_t i = start[2*index + play]; i < start[2*index + play + 1]; i++) {
+                    double m = mass[i];
+                    const double* constant = &constants[(size_t)constant_class[i] * lanes + begin];
+                    const double* ep = &lookup[(size_t)gather[i] * lanes + begin];
+                    for (int block = 0; block < width; block += LANE_BLOCK) {
+                        accumulate(sum + block, m, constant + block, ep + block);
+                    }
+                }
+            }
+
+            size_t row = (size_t)index * lanes;
+            for (int k = 0; k < width; k++) {
+                int lane = begin + k;
+                if (!active[lane]) continue;
+                double rush = epa_vals[0][k];
+                double pass = epa_vals[1][k];
+                if (rush > 1e10 || pass > 1e10 || rush <= -1e6) {
+                    std::cerr << down << "-" << yards_to_go << " " << yardline << ": Large EPAs encounted in lane " << lane
+                              << ": " << rush << ", " << pass << std::endl;
+                    blew_up[lane] = 1;
+                    active[lane] = 0;
+                    continue;
+                }
+                double epas[4];
+                int best = MaxPlay::best(priors[lane], down, yardline, rush, pass, epas);
+                run_ep[row + lane] = epas[0];
+                pass_ep[row + lane] = epas[1];
+                kick_ep[row + lane] = epas[2];
+                punt_ep[row + lane] = epas[3];
+                opt[row + lane] = best;
+                lookup[row + lane] = epas[best];
+            }
+        }
+    }
+};
+
+#endif
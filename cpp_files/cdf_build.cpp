@@ -0,0 +1,250 @@
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+#include "cdf_store.hpp"
+#include "thread_pool.hpp"
+
+using namespace std;
+
+// One distr_data file's samples, counted per down-distance key in file order as it streams in
+// NA samples ("NA" strings or null) are dropped, like vec[!is.na(vec)] in rscripts/cdf.R
+class SampleCounter : public nlohmann::json_sax<nlohmann::json> {
+public:
+    std::vector<std::string> keys;
+    std::vector<std::map<int32_t, uint32_t>> counts;  // by yards gained, ascending
+    std::vector<uint64_t> totals;
+    std::string error;
+
+    bool null() override { return sample_slot(); }
+    bool boolean(bool) override { return fail("a true/false sample"); }
+    bool number_integer(number_integer_t val) override { return add((int32_t)val); }
+    bool number_unsigned(number_unsigned_t val) override { return add((int32_t)val); }
+    bool number_float(number_float_t val, const string_t&) override { return add((int32_t)val); }  // as.integer
+    bool string(string_t& val) override { return (val == "NA") ? sample_slot() : fail("sample \"" + val + "\""); }
+    bool binary(binary_t&) override { return fail("binary data"); }
+
+    bool start_object(std::size_t) override {
+        return (depth++ == 0) ? true : fail("a nested object");
+    }
+    bool key(string_t& val) override {
+        keys.push_back(val);
+        counts.emplace_back();
+        totals.push_back(0);
+        return true;
+    }
+    bool end_object() override {
+        depth--;
+        return true;
+    }
+    bool start_array(std::size_t) override {
+        return (depth++ == 1) ? true : fail("a nested array");
+    }
+    bool end_array() override {
+        depth--;
+        return true;
+    }
+    bool parse_error(std::size_t position, const std::string&, const nlohmann::detail::exception& e) override {
+        return fail("a parse error at byte " + std::to_string(position) + " (" + e.what() + ")");
+    }
+
+private:
+    int depth = 0;
+
+    bool sample_slot() {
+        return (depth == 2) ? true : fail("a value outside a key's sample array");
+    }
+
+    bool add(int32_t yards) {
+        if (depth != 2) return fail("a value outside a key's sample array");
+        counts.back()[yards]++;
+        totals.back()++;
+        return true;
+    }
+
+    bool fail(const std::string& what) {
+        if (error.empty()) error = what;
+        return false;
+    }
+};
+
+// The CDF cdf.R's convert_to_cdf builds: outcomes ordered by how often they occur, rarest first, ties in ascending
+// yards (R's sort(table(vec)) is a stable sort of the value-ordered table), and the running share of samples
+// Keys with fewer samples than the threshold get the {0: 1} placeholder instead
+// Probabilities are rounded to 4 decimals like the JSON cdf.R writes (halves to even, as R rounds 1/32 to 0.0312),
+// unless full_precision
+void build_cdf(const map<int32_t, uint32_t>& counts, uint64_t total, double threshold, bool full_precision,
+               vector<int32_t>& values, vector<double>& cdf) {
+    values.clear();
+    cdf.clear();
+    if (total < threshold) {
+        values.push_back(0);
+        cdf.push_back(1.0);
+        return;
+    }
+
+    vector<pair<int32_t, uint32_t>> outcomes(counts.begin(), counts.end());
+    stable_sort(outcomes.begin(), outcomes.end(), [](const auto& a, const auto& b) { return a.second < b.second; });
+    double sum = 0.0;
+    for (const auto& [yards, count] : outcomes) {
+        sum += (double)count / total;
+        values.push_back(yards);
+        cdf.push_back(full_precision ? sum : nearbyint(sum * 1e4) / 1e4);
+    }
+}
+
+// Shortest fixed-point text that reads back to the same double, as jsonlite prints them (0.0004, never 4e-04)
+void append_number(string& out, double value) {
+    char text[64];
+    auto result = to_chars(text, text + sizeof(text), value, chars_format::fixed);
+    out.append(text, result.ptr - text);
+}
+
+template <typename T>
+void append_array(string& out, const vector<T>& items) {
+    if (items.size() == 1) {  // write_json(auto_unbox = TRUE) writes one-element vectors as scalars
+        append_number(out, items[0]);
+        return;
+    }
+    out += "[";
+    for (size_t i = 0; i < items.size(); i++) {
+        if (i > 0) out += ", ";
+        append_number(out, items[i]);
+    }
+    out += "]";
+}
+
+// Writes one cdf_data JSON file laid out like cdf.R's write_json(pretty = TRUE, auto_unbox = TRUE)
+bool write_cdf_json(const string& filename, const vector<string>& keys, const CDFFile& file) {
+    string out = keys.empty() ? "{}" : "{\n";
+    for (size_t k = 0; k < keys.size(); k++) {
+        out += "  \"" + keys[k] + "\": {\n    \"values\": ";
+        append_array(out, file.values[k]);
+        out += ",\n    \"cdf\": ";
+        append_array(out, file.cdfs[k]);
+        out += (k + 1 < keys.size()) ? "\n  },\n" : "\n  }\n}";
+    }
+    out += "\n";
+
+    ofstream json(filename);
+    if (!json.is_open()) {
+        cerr << "Error opening file: " << filename << endl;
+        return false;
+    }
+    json << out;
+    return bool(json);
+}
+
+int main(int argc, char* argv[]) {
+
+    // Optional flags: --json DIR also writes the cdf_data JSON files to DIR, --threads N builds N bins at a time
+    // (default every core; the output does not depend on it), --full-precision keeps probabilities unrounded
+    string json_dir;
+    int num_threads = max(1u, thread::hardware_concurrency());
+    bool full_precision = false;
+    vector<string> args;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--json" && i + 1 < argc) {
+            json_dir = argv[++i];
+        } else if (arg == "--threads" && i + 1 < argc) {
+            num_threads = stoi(argv[++i]);
+        } else if (arg == "--full-precision") {
+            full_precision = true;
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if(args.size() < 2 || args.size() > 3){
+        cout << "Need to input sample data directory and target bundle file, and optionally the minimum samples per key: " <<
+                "(./cdf_build.out distr_data cdf_data/cdf_bundle.bin [threshold, default 20] [--json cdf_data] [--threads N] [--full-precision])" << endl;
+        return 1;
+    }
+
+    string distr_dir = args[0];
+    string bundle_file = args[1];
+    double threshold = (args.size() > 2) ? stod(args[2]) : 20;
+
+    if (!json_dir.empty()) {
+        error_code error;
+        filesystem::create_directories(json_dir, error);
+    }
+
+    // One CDFFile per play type and bin, in the order CDFStore expects
+    size_t num_files = play_types.size() * yardline_bins.size();
+    vector<CDFFile> files(num_files);
+    vector<char> failed(num_files, 0);
+    ThreadPool pool(num_threads);
+    pool.parallel_for(num_files, [&](int begin, int end) {
+        for (int f = begin; f < end; f++) {
+            const string& play_type = play_types[f / yardline_bins.size()];
+            const string& bin = yardline_bins[f % yardline_bins.size()];
+            string input_file = distr_dir + "/" + play_type + "_distributions_yl" + bin + ".json";
+
+            ifstream input(input_file);
+            if (!input) {
+                cout << "Skipping missing file: " + input_file + "\n";
+                continue;
+            }
+            SampleCounter samples;
+            nlohmann::json::sax_parse(input, &samples);
+            if (!samples.error.empty()) {
+                cerr << "Error reading " + input_file + ": " + samples.error + "\n";
+                failed[f] = 1;
+                continue;
+            }
+
+            vector<string> keys;
+            for (size_t k = 0; k < samples.keys.size(); k++) {
+                int down, distance;
+                if (sscanf(samples.keys[k].c_str(), "%d-%d", &down, &distance) != 2 || down < 1 || down > 4 || distance < 1) {
+                    cerr << "Skipping bad down-distance key " + samples.keys[k] + " in " + input_file + "\n";
+                    continue;
+                }
+                keys.push_back(samples.keys[k]);
+                files[f].keys.push_back({down, distance});
+                files[f].values.emplace_back();
+                files[f].cdfs.emplace_back();
+                build_cdf(samples.counts[k], samples.totals[k], threshold, full_precision, files[f].values.back(),
+                          files[f].cdfs.back());
+            }
+
+            if (!json_dir.empty()) {
+                string output_file = json_dir + "/" + play_type + "_cdf_yl" + bin + ".json";
+                if (!write_cdf_json(output_file, keys, files[f])) {
+                    failed[f] = 1;
+                    continue;
+                }
+            }
+            cout << "Built CDFs for " + play_type + " yardline group " + bin + ", " + to_string(keys.size()) + " keys.\n";
+        }
+    });
+    if (count(failed.begin(), failed.end(), 1) > 0) {
+        return 1;
+    }
+
+    CDFStore cdf_store;
+    if (!cdf_store.load_files(files, distr_dir)) {
+        return 1;
+    }
+    if (!cdf_store.write_bundle(bundle_file)) {
+        cerr << "Error writing CDF bundle: " << bundle_file << endl;
+        return 1;
+    }
+
+    // Read it back so a bad bundle is caught here rather than by the simulators
+    CDFStore check;
+    if (!check.load_bundle(bundle_file)) {
+        return 1;
+    }
+
+    cout << "Packed " << cdf_store.outcome_count() << " outcomes into " << bundle_file << endl;
+    return 0;
+}
@@ -0,0 +1,36 @@
+#include <iostream>
+#include <string>
+#include "cdf_store.hpp"
+
+using namespace std;
+
+// One-time converter: packs the rush/pass CDF JSON files into a single binary bundle the simulators can mmap
+int main(int argc, char* argv[]) {
+
+    if(argc != 3){
+        cout << "Need to input cdf data directory and target bundle file: (./cdf_pack.out cdf_data cdf_data/cdf_bundle.bin)" << endl;
+        return 1;
+    }
+
+    string cdf_dir = argv[1];
+    string bundle_file = argv[2];
+
+    CDFStore cdf_store;
+    if (!cdf_store.load_json_dir(cdf_dir)) {
+        return 1;
+    }
+
+    if (!cdf_store.write_bundle(bundle_file)) {
+        cerr << "Error writing CDF bundle: " << bundle_file << endl;
+        return 1;
+    }
+
+    // Read it back so a bad bundle is caught here rather than by the simulators
+    CDFStore check;
+    if (!check.load_bundle(bundle_file)) {
+        return 1;
+    }
+
+    cout << "Packed " << cdf_store.outcome_count() << " outcomes into " << bundle_file << endl;
+    return 0;
+}
@@ -0,0 +1,418 @@
+#ifndef CDF_STORE_HPP
+#define CDF_STORE_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "json.hpp"
+#include "play_outcome.hpp"
+
+const std::vector<std::string> play_types = {"rush", "pass"};  // Play types
+
+// Yardline bins (as defined in your new structure)
+const std::vector<std::string> yardline_bins = {
+    "1", "2", "3", "4", "5", "6", "7", "8", "9", "10",
+    "11", "12", "13", "14", "15", "16", "17", "18", "19", "20",
+    "21-23", "24-27", "28-32", "33-38", "39-44", "45-50", "51-70", "71-85", "86-99"
+};
+
+// Function to generate filenames dynamically
+inline std::vector<std::string> generateFilenames(std::string dir_name) {
+    std::vector<std::string> filenames;
+    for (const auto& play_type : play_types) {
+        for (const auto& bin : yardline_bins) {
+            filenames.push_back(dir_name + "/" + play_type + "_cdf_yl" + bin + ".json");
+        }
+    }
+    return filenames;
+}
+
+// Non-owning view of one (play type, bin, down, distance) CDF
+struct CDFView {
+    const int32_t* values;        // as stored
+    const PlayOutcome* outcomes;  // decoded
+    const double* cdf;
+    uint32_t size;
+};
+
+// Binary CDF bundle layout (native byte order):
+//   CDFBundleHeader
+//   CDFBundleSlot index[num_play_types * num_bins * 4 * max_distance]
+//   int32_t values[num_outcomes], zero-padded to 8 bytes
+//   double cdf[num_outcomes]
+// checksum is FNV-1a 64 over everything after the header
+const char CDF_BUNDLE_MAGIC[8] = {'N', 'F', 'L', 'C', 'D', 'F', '\0', '\0'};
+const uint32_t CDF_BUNDLE_VERSION = 1;
+
+struct CDFBundleHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_play_types;
+    uint32_t num_bins;
+    uint32_t max_distance;
+    uint64_t num_outcomes;
+    uint64_t checksum;
+};
+
+struct CDFBundleSlot {
+    uint32_t offset;  // into values/cdf
+    uint32_t size;    // 0 if the key was missing
+};
+
+// The CDFs of one play type and yardline bin (one JSON file), in file order
+struct CDFFile {
+    std::vector<std::pair<int, int>> keys;  // (down, distance)
+    std::vector<std::vector<int32_t>> values;
+    std::vector<std::vector<double>> cdfs;
+};
+
+inline uint64_t fnv1a_64(const unsigned char* data, size_t size, uint64_t hash = 1469598103934665603ULL) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// All rush/pass CDFs, as flat value/probability arrays plus an index by (play type, bin, down, distance)
+// Either owns its arrays (loaded from JSON) or points into a mapped bundle file; the decoded outcomes are always
+// its own, built once per load
+class CDFStore {
+public:
+    CDFStore() {}
+    CDFStore(const CDFStore&) = delete;
+    CDFStore& operator=(const CDFStore&) = delete;
+    ~CDFStore() { unmap(); }
+
+    // Loads a bundle if path is a file, otherwise the JSON files in the path directory
+    bool load(const std::string& path) {
+        struct stat st;
+        if (stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode)) {
+            return load_bundle(path);
+        }
+        return load_json_dir(path);
+    }
+
+    bool load_json_dir(const std::string& dir_name) {
+        unmap();
+        std::vector<std::string> filenames = generateFilenames(dir_name);
+        std::vector<CDFFile> files(filenames.size());
+
+        // Every file is parsed first, since the distance range is only known once all keys are seen
+        for (size_t f = 0; f < filenames.size(); f++) {
+            std::ifstream file(filenames[f]);
+            if (!file) {
+                std::cerr << "Error opening file: " << filenames[f] << std::endl;
+                return false;
+            }
+
+            nlohmann::json jsonData;
+            file >> jsonData;
+
+            for (auto& [key, value] : jsonData.items()) {
+                int down, distance;
+                if (sscanf(key.c_str(), "%d-%d", &down, &distance) != 2 || down < 1 || down > 4 || distance < 1) {
+                    std::cerr << "Skipping bad down-distance key " << key << " in " << filenames[f] << std::endl;
+                    continue;
+                }
+
+                std::vector<int32_t> entry_values;
+                std::vector<double> entry_cdf;
+                try {
+                    entry_values = value["values"].get<std::vector<int32_t>>();
+                    entry_cdf = value["cdf"].get<std::vector<double>>();
+                }
+                catch (const std::exception& e){
+                    entry_values.assign(1, value["values"].get<int32_t>());
+                    entry_cdf.assign(1, value["cdf"].get<double>());
+                }
+                if (entry_values.size() != entry_cdf.size()) {
+                    std::cerr << "CDF " << key << " in " << filenames[f] << " has " << entry_values.size() << " values and "
+                              << entry_cdf.size() << " probabilities" << std::endl;
+                    return false;
+                }
+
+                files[f].keys.push_back({down, distance});
+                files[f].values.push_back(move(entry_values));
+                files[f].cdfs.push_back(move(entry_cdf));
+            }
+
+            std::cout << "Loaded CDF data from " << filenames[f] << ", " << files[f].keys.size() << " keys." << std::endl;
+        }
+
+        return load_files(files, dir_name);
+    }
+
+    // Takes CDFs built in memory (cdf_build), one CDFFile per play type and bin in generateFilenames order
+    bool load_files(const std::vector<CDFFile>& files, const std::string& source) {
+        unmap();
+        max_distance = 0;
+        for (const CDFFile& file : files) {
+            for (const auto& [down, distance] : file.keys) {
+                if (distance > (int)max_distance) max_distance = distance;
+            }
+        }
+
+        num_play_types = play_types.size();
+        num_bins = yardline_bins.size();
+        owned_slots.assign(num_play_types * num_bins * 4 * max_distance, CDFBundleSlot{0, 0});
+        owned_values.clear();
+        owned_cdf.clear();
+
+        // Outcomes are laid out in slot order, whatever order the keys came in, so the same CDFs always make the
+        // same bundle
+        std::vector<std::pair<int, int>> source_of(owned_slots.size(), {-1, -1});  // (file, key) behind each slot
+        for (size_t f = 0; f < files.size() && f < (size_t)num_play_types * num_bins; f++) {
+            int play_type = f / num_bins;
+            int bin = f % num_bins;
+            for (size_t k = 0; k < files[f].keys.size(); k++) {
+                source_of[slot_index(play_type, bin, files[f].keys[k].first, files[f].keys[k].second)] = {(int)f, (int)k};
+            }
+        }
+        for (size_t i = 0; i < owned_slots.size(); i++) {
+            if (source_of[i].first < 0) continue;
+            const std::vector<int32_t>& entry_values = files[source_of[i].first].values[source_of[i].second];
+            const std::vector<double>& entry_cdf = files[source_of[i].first].cdfs[source_of[i].second];
+            owned_slots[i].offset = owned_values.size();
+            owned_slots[i].size = entry_values.size();
+            owned_values.insert(owned_values.end(), entry_values.begin(), entry_values.end());
+            owned_cdf.insert(owned_cdf.end(), entry_cdf.begin(), entry_cdf.end());
+        }
+
+        slots = owned_slots.data();
+        values = owned_values.data();
+        cdf = owned_cdf.data();
+        num_outcomes = owned_values.size();
+        return validate(source) && decode(source);
+    }
+
+    bool load_bundle(const std::string& filename) {
+        unmap();
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Error opening file: " << filename << std::endl;
+            return false;
+        }
+        struct stat st;
+        fstat(fd, &st);
+        map_size = st.st_size;
+        void* addr = (map_size > 0) ? mmap(nullptr, map_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+        close(fd);
+        if (addr == MAP_FAILED) {
+            std::cerr << "Error mapping CDF bundle: " << filename << std::endl;
+            map_size = 0;
+            return false;
+        }
+        map_addr = addr;
+
+        const unsigned char* base = static_cast<const unsigned char*>(map_addr);
+        if (map_size < sizeof(CDFBundleHeader)) {
+            std::cerr << "CDF bundle too small: " << filename << std::endl;
+            unmap();
+            return false;
+        }
+        CDFBundleHeader header;
+        memcpy(&header, base, sizeof(header));
+        if (memcmp(header.magic, CDF_BUNDLE_MAGIC, sizeof(header.magic)) != 0) {
+            std::cerr << "Not a CDF bundle: " << filename << std::endl;
+            unmap();
+            return false;
+        }
+        if (header.version != CDF_BUNDLE_VERSION) {
+            std::cerr << "CDF bundle " << filename << " is version " << header.version << ", expected " << CDF_BUNDLE_VERSION
+                      << " (re-run cdf_pack)" << std::endl;
+            unmap();
+            return false;
+        }
+
+        num_play_types = header.num_play_types;
+        num_bins = header.num_bins;
+        max_distance = header.max_distance;
+        num_outcomes = header.num_outcomes;
+        if (num_play_types != play_types.size() || num_bins != yardline_bins.size()) {
+            std::cerr << "CDF bundle " << filename << " has " << num_play_types << " play types and " << num_bins
+                      << " bins, expected " << play_types.size() << " and " << yardline_bins.size() << std::endl;
+            unmap();
+            return false;
+        }
+
+        size_t slots_offset = sizeof(CDFBundleHeader);
+        size_t values_offset = slots_offset + num_slots() * sizeof(CDFBundleSlot);
+        size_t cdf_offset = values_offset + padded_values_bytes(num_outcomes);
+        if (cdf_offset + num_outcomes * sizeof(double) != map_size) {
+            std::cerr << "CDF bundle " << filename << " is truncated or corrupt" << std::endl;
+            unmap();
+            return false;
+        }
+        if (fnv1a_64(base + slots_offset, map_size - slots_offset) != header.checksum) {
+            std::cerr << "CDF bundle " << filename << " failed its checksum" << std::endl;
+            unmap();
+            return false;
+        }
+
+        slots = reinterpret_cast<const CDFBundleSlot*>(base + slots_offset);
+        values = reinterpret_cast<const int32_t*>(base + values_offset);
+        cdf = reinterpret_cast<const double*>(base + cdf_offset);
+        if (!validate(filename) || !decode(filename)) {
+            unmap();
+            return false;
+        }
+
+        std::cout << "Mapped CDF bundle " << filename << ", " << num_outcomes << " outcomes." << std::endl;
+        return true;
+    }
+
+    bool write_bundle(const std::string& filename) const {
+        std::vector<unsigned char> body(num_slots() * sizeof(CDFBundleSlot) + padded_values_bytes(num_outcomes)
+                                        + num_outcomes * sizeof(double), 0);
+        unsigned char* out = body.data();
+        memcpy(out, slots, num_slots() * sizeof(CDFBundleSlot));
+        out += num_slots() * sizeof(CDFBundleSlot);
+        memcpy(out, values, num_outcomes * sizeof(int32_t));
+        out += padded_values_bytes(num_outcomes);
+        memcpy(out, cdf, num_outcomes * sizeof(double));
+
+        CDFBundleHeader header;
+        memcpy(header.magic, CDF_BUNDLE_MAGIC, sizeof(header.magic));
+        header.version = CDF_BUNDLE_VERSION;
+        header.num_play_types = num_play_types;
+        header.num_bins = num_bins;
+        header.max_distance = max_distance;
+        header.num_outcomes = num_outcomes;
+        header.checksum = fnv1a_64(body.data(), body.size());
+
+        std::ofstream file(filename, std::ios::binary);
+        if (!file) {
+            std::cerr << "Error opening file: " << filename << std::endl;
+            return false;
+        }
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char*>(body.data()), body.size());
+        return bool(file);
+    }
+
+    // Empty view if the key is not in the data (see contains), or any part of it is out of range; never modifies
+    // the store
+    CDFView find(int play_type, int bin, int down, int distance) const {
+        if (play_type < 0 || play_type >= (int)num_play_types || bin < 0 || bin >= (int)num_bins || down < 1 || down > 4 ||
+            distance < 1 || distance > (int)max_distance) {
+            return CDFView{nullptr, nullptr, nullptr, 0};
+        }
+        const CDFBundleSlot& slot = slots[slot_index(play_type, bin, down, distance)];
+        return CDFView{values + slot.offset, outcomes.data() + slot.offset, cdf + slot.offset, slot.size};
+    }
+
+    bool contains(int play_type, int bin, int down, int distance) const {
+        return find(play_type, bin, down, distance).size > 0;
+    }
+
+    uint64_t outcome_count() const { return num_outcomes; }
+
+    // FNV-1a over every CDF of one play type and yardline bin (one JSON file), the same whether the data came
+    // from JSON or a bundle, so a re-run can tell which files changed
+    uint64_t content_hash(int play_type, int bin) const {
+        uint64_t hash = fnv1a_64(nullptr, 0);
+        for (int down = 1; down <= 4; down++) {
+            for (int distance = 1; distance <= (int)max_distance; distance++) {
+                CDFView view = find(play_type, bin, down, distance);
+                if (view.size == 0) continue;
+                int32_t key[3] = {down, distance, (int32_t)view.size};
+                hash = fnv1a_64(reinterpret_cast<const unsigned char*>(key), sizeof(key), hash);
+                hash = fnv1a_64(reinterpret_cast<const unsigned char*>(view.values), view.size * sizeof(int32_t), hash);
+                hash = fnv1a_64(reinterpret_cast<const unsigned char*>(view.cdf), view.size * sizeof(double), hash);
+            }
+        }
+        return hash;
+    }
+
+private:
+    uint32_t num_play_types = 0;
+    uint32_t num_bins = 0;
+    uint32_t max_distance = 0;
+    uint64_t num_outcomes = 0;
+
+    const CDFBundleSlot* slots = nullptr;
+    const int32_t* values = nullptr;
+    const double* cdf = nullptr;
+
+    std::vector<CDFBundleSlot> owned_slots;
+    std::vector<int32_t> owned_values;
+    std::vector<double> owned_cdf;
+    std::vector<PlayOutcome> outcomes;
+
+    void* map_addr = nullptr;
+    size_t map_size = 0;
+
+    size_t num_slots() const { return (size_t)num_play_types * num_bins * 4 * max_distance; }
+
+    size_t slot_index(int play_type, int bin, int down, int distance) const {
+        return (((size_t)play_type * num_bins + bin) * 4 + (down - 1)) * max_distance + (distance - 1);
+    }
+
+    // Every CDF must lie inside the outcome arrays, be non-decreasing from 0 and end at 1 (up to the 4-decimal
+    // rounding of the JSON files), so lookups can hand out views without further checks
+    bool validate(const std::string& source) const {
+        for (uint32_t play_type = 0; play_type < num_play_types; play_type++) {
+            for (uint32_t bin = 0; bin < num_bins; bin++) {
+                for (int down = 1; down <= 4; down++) {
+                    for (int distance = 1; distance <= (int)max_distance; distance++) {
+                        const CDFBundleSlot& slot = slots[slot_index(play_type, bin, down, distance)];
+                        if (slot.size == 0) continue;
+
+                        const char* problem = nullptr;
+                        if ((uint64_t)slot.offset + slot.size > num_outcomes) {
+                            problem = "runs past the outcome arrays";
+                        } else {
+                            double prev = 0.0;
+                            for (uint32_t i = 0; i < slot.size && !problem; i++) {
+                                if (!(cdf[slot.offset + i] >= prev)) problem = "is not non-decreasing from 0";
+                                prev = cdf[slot.offset + i];
+                            }
+                            if (!problem && std::abs(prev - 1.0) > 1e-3) problem = "does not end at 1";
+                        }
+                        if (problem) {
+                            std::cerr << "CDF for " << play_types[play_type] << " " << down << "-" << distance << " in bin "
+                                      << yardline_bins[bin] << " of " << source << " " << problem << std::endl;
+                            return false;
+                        }
+                    }
+                }
+            }
+        }
+        return true;
+    }
+
+    // Every stored value decoded once, so the engines never read the sample encoding
+    bool decode(const std::string& source) {
+        outcomes.resize(num_outcomes);
+        for (uint64_t i = 0; i < num_outcomes; i++) {
+            if (!play_in_range(values[i])) {
+                std::cerr << "CDF outcome " << values[i] << " in " << source << " is out of range" << std::endl;
+                return false;
+            }
+            outcomes[i] = decode_play(values[i]);
+        }
+        return true;
+    }
+
+    static size_t padded_values_bytes(uint64_t count) {
+        return (count * sizeof(int32_t) + 7) & ~size_t(7);
+    }
+
+    void unmap() {
+        if (map_addr) munmap(map_addr, map_size);
+        map_addr = nullptr;
+        map_size = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef CONVERGENCE_HPP
+#define CONVERGENCE_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "csv_writer.hpp"
+#include "state_table.hpp"
+
+// How far one epoch moved the EPs, against the table it started from
+struct EpochResiduals {
+    double max_ep_change = 0.0;      // over every computed state's EP
+    double rms_ep_change = 0.0;
+    double max_prior_change = 0.0;   // first-and-10 EPs the epoch produced against the prior it ran with (the
+    double rms_prior_change = 0.0;   // fixed-point residual, also when the next prior is accelerated)
+    int choice_flips = 0;            // computed states whose best play changed
+    double seconds = 0.0;            // since the first epoch started
+};
+
+// Per-epoch residuals for the epoch loops, logged to stdout and optionally saved as a small CSV report with one
+// row per epoch (Converged is 1 on the last row if it met the tolerance), so the epochs a table needs can be read
+// off a run
+class ConvergenceLog {
+public:
+    // The report is written by finish, so a --solve run (no epochs) leaves no file behind
+    void set_report(const std::string& filename) {
+        report_name = filename;
+    }
+
+    const std::string& report() const { return report_name; }   // empty without --report
+
+    // The table the first epoch starts from
+    void start(const StateTable& table) {
+        opt = table.opt;
+        started = std::chrono::steady_clock::now();
+    }
+
+    // Residuals of an epoch that just finished: start_max and prior are the EPs and prior it ran with, table and
+    // target the EPs and first-and-10 EPs it produced
+    EpochResiduals record(int epoch, const std::vector<double>& start_max, const StateTable& table,
+                          const std::vector<double>& prior, const std::vector<double>& target) {
+        EpochResiduals r;
+        double sum = 0.0;
+        int count = 0;
+        for (int index = 0; index < NUM_STATES; index++) {
+            if (!table.computed[index]) continue;
+            double change = std::abs(table.max[index] - start_max[index]);
+            r.max_ep_change = std::max(r.max_ep_change, change);
+            sum += change * change;
+            count++;
+            if (table.opt[index] != opt[index]) r.choice_flips++;
+        }
+        r.rms_ep_change = (count > 0) ? std::sqrt(sum / count) : 0.0;
+
+        sum = 0.0;
+        for (size_t i = 0; i < target.size(); i++) {
+            double change = std::abs(target[i] - prior[i]);
+            r.max_prior_change = std::max(r.max_prior_change, change);
+            sum += change * change;
+        }
+        r.rms_prior_change = target.empty() ? 0.0 : std::sqrt(sum / target.size());
+
+        r.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        opt = table.opt;
+        epochs.push_back(r);
+
+        std::cout << "Epoch " << epoch << ": max EP change " << r.max_ep_change << " (RMS " << r.rms_ep_change
+                  << "), max prior EP change " << r.max_prior_change << " (RMS " << r.rms_prior_change << "), "
+                  << r.choice_flips << " best plays changed" << std::endl;
+
+        return r;
+    }
+
+    // Writes the report, if one was asked for
+    void finish(bool converged) {
+        if (report_name.empty()) return;
+        CSVWriter report(true);
+        if (!report.open(report_name)) return;
+        report.line("Epoch,Max_EP_Change,RMS_EP_Change,Max_Prior_Change,RMS_Prior_Change,Choice_Flips,Seconds,Converged");
+        for (size_t i = 0; i < epochs.size(); i++) {
+            const EpochResiduals& r = epochs[i];
+            report.field((int)i + 1);
+            report.field(r.max_ep_change);
+            report.field(r.rms_ep_change);
+            report.field(r.max_prior_change);
+            report.field(r.rms_prior_change);
+            report.field(r.choice_flips);
+            report.field(r.seconds);
+            report.field((converged && i + 1 == epochs.size()) ? 1 : 0);
+            report.end_row();
+        }
+        if (!report.close()) {
+            std::cerr << "Error writing file: " << report_name << std::endl;
+            return;
+        }
+        std::cout << "Convergence report saved to: " << report_name << std::endl;
+    }
+
+private:
+    std::vector<int> opt;
+    std::chrono::steady_clock::time_point started;
+    std::vector<EpochResiduals> epochs;
+    std::string report_name;
+};
+
+#endif
@@ -0,0 +1,68 @@
+#ifndef COUNTER_RNG_HPP
+#define COUNTER_RNG_HPP
+
+#include <cstdint>
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3")
+// Output is a pure function of (seed, stream, position), so any number of threads can each take whole
+// streams and the draws never depend on which thread ran them or in what order
+class CounterRNG {
+public:
+    CounterRNG(uint64_t seed, uint64_t stream) {
+        key[0] = (uint32_t)seed;
+        key[1] = (uint32_t)(seed >> 32);
+        counter[0] = 0;
+        counter[1] = 0;
+        counter[2] = (uint32_t)stream;
+        counter[3] = (uint32_t)(stream >> 32);
+    }
+
+    uint32_t next_u32() {
+        if (used == 4) refill();
+        return block[used++];
+    }
+
+    // Uniform in [0, 1) with 53 random bits
+    double uniform() {
+        uint64_t bits = ((uint64_t)next_u32() << 32) | next_u32();
+        return (bits >> 11) * (1.0 / 9007199254740992.0);
+    }
+
+    // Uniform integer in [0, n), by multiply-shift (bias below 2^-32 * n)
+    uint32_t below(uint32_t n) {
+        return (uint32_t)(((uint64_t)next_u32() * n) >> 32);
+    }
+
+private:
+    uint32_t key[2];
+    uint32_t counter[4];
+    uint32_t block[4];
+    int used = 4;
+
+    void refill() {
+        uint32_t c[4] = {counter[0], counter[1], counter[2], counter[3]};
+        uint32_t k[2] = {key[0], key[1]};
+        for (int round = 0; round < 10; round++) {
+            uint64_t product0 = (uint64_t)0xD2511F53u * c[0];
+            uint64_t product1 = (uint64_t)0xCD9E8D57u * c[2];
+            uint32_t next[4] = {(uint32_t)(product1 >> 32) ^ c[1] ^ k[0], (uint32_t)product1,
+                                (uint32_t)(product0 >> 32) ^ c[3] ^ k[1], (uint32_t)product0};
+            c[0] = next[0];
+            c[1] = next[1];
+            c[2] = next[2];
+            c[3] = next[3];
+            k[0] += 0x9E3779B9u;
+            k[1] += 0xBB67AE85u;
+        }
+        block[0] = c[0];
+        block[1] = c[1];
+        block[2] = c[2];
+        block[3] = c[3];
+        used = 0;
+
+        // 64-bit position within the stream
+        if (++counter[0] == 0) ++counter[1];
+    }
+};
+
+#endif
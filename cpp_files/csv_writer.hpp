@@ -0,0 +1,117 @@
+#ifndef CSV_WRITER_HPP
+#define CSV_WRITER_HPP
+
+#include <charconv>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include "state_table.hpp"
+
+// Buffered CSV output with fixed float formatting, flushed to the file in large blocks
+// Default doubles match ostream's default (6 significant digits); full precision writes the
+// shortest text that reads back to the same double
+class CSVWriter {
+public:
+    explicit CSVWriter(bool full_precision = false) : full_precision(full_precision) {
+        buffer.reserve(FLUSH_BYTES + 256);
+    }
+    ~CSVWriter() { close(); }
+
+    CSVWriter(const CSVWriter&) = delete;
+    CSVWriter& operator=(const CSVWriter&) = delete;
+
+    bool open(const std::string& filename) {
+        close();
+        file = fopen(filename.c_str(), "w");
+        if (!file) {
+            std::cerr << "Error opening file: " << filename << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    bool is_open() const { return file != nullptr; }
+
+    // Writes a full line as is, for headers
+    void line(const char* text) {
+        buffer += text;
+        buffer += '\n';
+        row_start = true;
+    }
+
+    // Text written as is, so it must already be CSV-escaped
+    void field(std::string_view text) {
+        separate();
+        buffer.append(text.data(), text.size());
+    }
+
+    void field(int value) {
+        separate();
+        char text[16];
+        auto result = std::to_chars(text, text + sizeof(text), value);
+        buffer.append(text, result.ptr - text);
+    }
+
+    void field(long value) {
+        separate();
+        char text[24];
+        auto result = std::to_chars(text, text + sizeof(text), value);
+        buffer.append(text, result.ptr - text);
+    }
+
+    void field(double value) {
+        separate();
+        char text[32];
+        auto result = full_precision ? std::to_chars(text, text + sizeof(text), value)
+                                     : std::to_chars(text, text + sizeof(text), value, std::chars_format::general, 6);
+        buffer.append(text, result.ptr - text);
+    }
+
+    void end_row() {
+        buffer += '\n';
+        row_start = true;
+        if (buffer.size() >= FLUSH_BYTES) flush();
+    }
+
+    // Flushes and closes, false if any write failed
+    bool close() {
+        if (!file) return true;
+        flush();
+        bool ok = !write_failed && fclose(file) == 0;
+        file = nullptr;
+        write_failed = false;
+        return ok;
+    }
+
+private:
+    static const size_t FLUSH_BYTES = 1 << 20;
+
+    bool full_precision;
+    bool row_start = true;
+    bool write_failed = false;
+    FILE* file = nullptr;
+    std::string buffer;
+
+    void separate() {
+        if (!row_start) buffer += ',';
+        row_start = false;
+    }
+
+    void flush() {
+        if (fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) write_failed = true;
+        buffer.clear();
+    }
+};
+
+// One state's columns, as saved by the simulators: Run_EP,Pass_EP,Kick_EP,Punt_EP,EP,Opt_Choice
+inline void write_state_fields(CSVWriter& writer, const StateTable& table, int index) {
+    writer.field(table.run[index]);
+    writer.field(table.pass[index]);
+    writer.field(table.kick[index]);
+    writer.field(table.punt[index]);
+    writer.field(table.max[index]);
+    writer.field(table.opt[index]);
+}
+
+#endif
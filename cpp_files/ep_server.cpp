@@ -0,0 +1,260 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <climits>
+#include <csignal>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "sim_engine.hpp"
+
+using namespace std;
+
+// Long-running EP/EPA lookup server over a converged state table (final_eps.csv from simulator or simulator_norm)
+// Clients send batches of (down, distance, yardline, outcome) over a Unix socket and get EP and EPA back.
+// A rebuilt table is loaded in the background and swapped in atomically; each batch is answered from one table
+//
+// Wire format (native byte order, both directions on the same stream):
+//   request   uint32 count, then count x EPQuery
+//   response  uint32 count, uint32 table version, then count x EPAnswer
+
+const int32_t NO_OUTCOME = INT32_MIN;   // EP only, EPA is NaN
+const uint32_t MAX_BATCH = 1 << 20;     // larger batches close the connection
+const char* DEFAULT_SOCKET = "/tmp/ep_server.sock";
+
+struct EPQuery {
+    int32_t down;
+    int32_t distance;
+    int32_t yardline;
+    int32_t outcome;   // yards gained, or a turnover in the cdf_data encoding (< -1000), or NO_OUTCOME
+};
+
+struct EPAnswer {
+    double ep;    // NaN when the query is rejected: the state is off the grid or the outcome does not decode
+    double epa;   // EP after the outcome minus ep, NaN without an outcome or when rejected
+};
+
+shared_ptr<const EPTable> current_table;   // read with atomic_load, replaced with atomic_store
+volatile sig_atomic_t reload_requested = 0;
+
+void request_reload(int) {
+    reload_requested = 1;
+}
+
+EPAnswer answer(const EPTable& table, const EPQuery& query) {
+    EPAnswer result = {NAN, NAN};
+    if (query.down < 1 || query.down > 4 || query.yardline < 1 || query.yardline > NUM_YARDLINES ||
+        query.distance < 1 || query.distance > query.yardline) {
+        return result;
+    }
+    if (query.outcome != NO_OUTCOME && !play_in_range(query.outcome)) {
+        return result;
+    }
+
+    int index = table_state(query.down, query.distance, query.yardline);
+    result.ep = table.states.max[index];
+    if (query.outcome != NO_OUTCOME) {
+        result.epa = table_epa(table, index, query.distance, query.outcome);
+    }
+    return result;
+}
+
+bool read_full(int fd, void* buffer, size_t size) {
+    char* data = (char*)buffer;
+    while (size > 0) {
+        ssize_t n = read(fd, data, size);
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+bool write_full(int fd, const void* buffer, size_t size) {
+    const char* data = (const char*)buffer;
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+// Answers batches on one connection until the client closes it
+void serve_client(int fd) {
+    vector<EPQuery> queries;
+    vector<EPAnswer> answers;
+    uint32_t count;
+
+    while (read_full(fd, &count, sizeof(count))) {
+        if (count > MAX_BATCH) break;
+        queries.resize(count);
+        if (!read_full(fd, queries.data(), count * sizeof(EPQuery))) break;
+
+        shared_ptr<const EPTable> table = atomic_load(&current_table);  // one table for the whole batch
+        answers.resize(count);
+        for (uint32_t i = 0; i < count; i++) {
+            answers[i] = answer(*table, queries[i]);
+        }
+
+        uint32_t header[2] = {count, table->version};
+        if (!write_full(fd, header, sizeof(header)) || !write_full(fd, answers.data(), count * sizeof(EPAnswer))) break;
+    }
+    close(fd);
+}
+
+// Modification time and size, so a rewrite within the same second still counts as a change
+pair<time_t, off_t> file_version(const string& filename) {
+    struct stat info;
+    if (stat(filename.c_str(), &info) != 0) return {0, 0};
+    return {info.st_mtime, info.st_size};
+}
+
+// Reloads the table on SIGHUP, or when the file changes if poll_seconds > 0
+void watch_table(string filename, int poll_seconds) {
+    pair<time_t, off_t> seen = file_version(filename);
+    auto last_poll = chrono::steady_clock::now();
+    while (true) {
+        this_thread::sleep_for(chrono::milliseconds(200));
+        bool changed = false;
+        if (poll_seconds > 0) {
+            if (chrono::steady_clock::now() - last_poll >= chrono::seconds(poll_seconds)) {
+                last_poll = chrono::steady_clock::now();
+                changed = file_version(filename) != seen;
+            }
+        }
+        if (!reload_requested && !changed) continue;
+        reload_requested = 0;
+
+        seen = file_version(filename);
+        auto table = make_shared<EPTable>();
+        if (!loadEPTable(filename, *table)) {
+            continue;  // keep serving the old table, try again on the next change
+        }
+        table->version = atomic_load(&current_table)->version + 1;
+        atomic_store(&current_table, shared_ptr<const EPTable>(table));
+        cout << "Loaded table version " << table->version << " from " << filename << endl;
+    }
+}
+
+int serve(const string& table_file, const string& socket_path, int poll_seconds) {
+    auto table = make_shared<EPTable>();
+    if (!loadEPTable(table_file, *table)) {
+        return 1;
+    }
+    table->version = 1;
+    atomic_store(&current_table, shared_ptr<const EPTable>(table));
+    cout << "Loaded table version 1 from " << table_file << endl;
+
+    signal(SIGPIPE, SIG_IGN);
+    signal(SIGHUP, request_reload);
+
+    int server = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (server < 0 || socket_path.size() >= sizeof(address.sun_path)) {
+        cerr << "Error opening socket: " << socket_path << endl;
+        return 1;
+    }
+    socket_path.copy(address.sun_path, socket_path.size());
+    unlink(socket_path.c_str());
+    if (bind(server, (sockaddr*)&address, sizeof(address)) < 0 || listen(server, 64) < 0) {
+        cerr << "Error opening socket: " << socket_path << endl;
+        return 1;
+    }
+    cout << "Serving EP queries on " << socket_path << endl;
+
+    thread(watch_table, table_file, poll_seconds).detach();
+
+    while (true) {
+        int client = accept(server, nullptr, nullptr);
+        if (client < 0) continue;
+        thread(serve_client, client).detach();
+    }
+}
+
+// Client: reads "down distance yardline [outcome]" lines from stdin, sends them as one batch, prints CSV
+int query(const string& socket_path) {
+    vector<EPQuery> queries;
+    string line;
+    while (getline(cin, line)) {
+        stringstream ss(line);
+        EPQuery q = {0, 0, 0, NO_OUTCOME};
+        if (!(ss >> q.down >> q.distance >> q.yardline)) continue;
+        ss >> q.outcome;
+        queries.push_back(q);
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    socket_path.copy(address.sun_path, min(socket_path.size(), sizeof(address.sun_path) - 1));
+    if (fd < 0 || connect(fd, (sockaddr*)&address, sizeof(address)) < 0) {
+        cerr << "Error opening socket: " << socket_path << endl;
+        return 1;
+    }
+
+    auto start = chrono::steady_clock::now();
+    uint32_t count = queries.size();
+    uint32_t header[2];
+    vector<EPAnswer> answers(count);
+    if (!write_full(fd, &count, sizeof(count)) || !write_full(fd, queries.data(), count * sizeof(EPQuery)) ||
+        !read_full(fd, header, sizeof(header)) || !read_full(fd, answers.data(), count * sizeof(EPAnswer))) {
+        cerr << "Error reading from socket: " << socket_path << endl;
+        return 1;
+    }
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    close(fd);
+
+    cout << "Down,Distance,Yardline,Outcome,EP,EPA" << endl;
+    for (uint32_t i = 0; i < count; i++) {
+        cout << queries[i].down << "," << queries[i].distance << "," << queries[i].yardline << ",";
+        if (queries[i].outcome != NO_OUTCOME) cout << queries[i].outcome;
+        cout << "," << answers[i].ep << "," << answers[i].epa << endl;
+    }
+    cerr << count << " queries answered by table version " << header[1] << " in " << seconds * 1e6 << " us" << endl;
+    return 0;
+}
+
+int main(int argc, char* argv[]) {
+
+    // Optional flags: --watch SECONDS reloads the table when the file changes (SIGHUP always reloads),
+    // --query runs as a client instead
+    int poll_seconds = 0;
+    bool client = false;
+    vector<string> args;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--watch" && i + 1 < argc) {
+            poll_seconds = stoi(argv[++i]);
+        } else if (arg == "--query") {
+            client = true;
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if (client) {
+        if (args.size() > 1) {
+            cout << "Client takes an optional socket path: (./ep_server.out --query [socket] < queries.txt)" << endl;
+            return 1;
+        }
+        return query((args.size() > 0) ? args[0] : DEFAULT_SOCKET);
+    }
+
+    if (args.size() < 1 || args.size() > 2) {
+        cout << "Need to input an EP table, and optionally a socket path: " <<
+                "(./ep_server.out final_eps.csv [socket, default " << DEFAULT_SOCKET << "] [--watch seconds])" << endl;
+        return 1;
+    }
+
+    return serve(args[0], (args.size() > 1) ? args[1] : DEFAULT_SOCKET, poll_seconds);
+}
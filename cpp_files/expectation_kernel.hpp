@@ -0,0 +1,64 @@
+#ifndef EXPECTATION_KERNEL_HPP
+#define EXPECTATION_KERNEL_HPP
+
+#include <cstdint>
+#include <vector>
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+#include "state_table.hpp"
+
+// CDFs compiled once into a sparse transition table, one row of outcomes per state and play (CSR-style, rows
+// delimited by start): each outcome's probability mass (cdf[i] - cdf[i-1]) and its decoded result, which is
+// constant + lookup[gather] for an EP lookup table laid out as
+//   [0, NUM_STATES)                   EP of each state (the successor when the drive goes on)
+//   [NUM_STATES, NUM_STATES + 99)     negated first-and-10 EP of the other team at each yardline
+//   LOOKUP_ZERO                       0, for results that end the possession with a fixed number of points
+// so an expectation is a gather and a multiply-add per outcome, with no branches on the outcome
+const int LOOKUP_OPPONENT = NUM_STATES;
+const int LOOKUP_ZERO = NUM_STATES + NUM_YARDLINES;
+const int LOOKUP_SIZE = LOOKUP_ZERO + 1;
+
+struct OutcomeTable {
+    std::vector<double> mass;
+    std::vector<double> constant;
+    std::vector<int32_t> gather;
+    std::vector<uint32_t> start;   // outcomes of state s and play p are [start[2*s+p], start[2*s+p+1])
+
+    bool empty() const { return start.empty(); }
+};
+
+// Sum of mass[i] * (constant[i] + lookup[gather[i]])
+// The scalar build adds outcomes in order, exactly like the per-outcome loops it replaces. The AVX2 (4 lanes) and
+// AVX-512 (8 lanes) builds keep one partial sum per lane and add the lanes at the end, so a state's expectation can
+// differ from the in-order sum in the last bits: at most about n * 2^-53 * sum |mass[i] * result[i]| for n outcomes,
+// around 1e-14 for these tables. Converged EP tables from the two builds agree to about 1e-12
+inline double expectation(const double* mass, const double* constant, const int32_t* gather, uint32_t n,
+                          const double* lookup) {
+    double sum = 0.0;
+    uint32_t i = 0;
+#if defined(__AVX512F__)
+    __m512d acc = _mm512_setzero_pd();
+    for (; i + 8 <= n; i += 8) {
+        __m256i index = _mm256_loadu_si256((const __m256i*)(gather + i));
+        __m512d result = _mm512_add_pd(_mm512_loadu_pd(constant + i), _mm512_i32gather_pd(index, lookup, 8));
+        acc = _mm512_add_pd(acc, _mm512_mul_pd(_mm512_loadu_pd(mass + i), result));
+    }
+    sum = _mm512_reduce_add_pd(acc);
+#elif defined(__AVX2__)
+    __m256d acc = _mm256_setzero_pd();
+    for (; i + 4 <= n; i += 4) {
+        __m128i index = _mm_loadu_si128((const __m128i*)(gather + i));
+        __m256d result = _mm256_add_pd(_mm256_loadu_pd(constant + i), _mm256_i32gather_pd(lookup, index, 8));
+        acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(mass + i), result));
+    }
+    __m128d pair = _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+    sum = _mm_cvtsd_f64(_mm_add_sd(pair, _mm_unpackhi_pd(pair, pair)));
+#endif
+    for (; i < n; i++) {
+        sum += mass[i] * (constant[i] + lookup[gather[i]]);
+    }
+    return sum;
+}
+
+#endif
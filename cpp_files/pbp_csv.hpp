@@ -0,0 +1,222 @@
+#ifndef PBP_CSV_HPP
+#define PBP_CSV_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "progress.hpp"
+
+// Streaming reader for play-by-play exports (the nflfastR columns rscripts/data.R reads), shared by pbp_scorer
+// and pbp_ingest: the CSV is read in large blocks of complete lines, only the wanted columns are split out, and
+// runs and passes are encoded the way data.R encodes its samples
+
+const size_t READ_BYTES = 1 << 22;
+
+// Columns read from the export; the optional ones count as 0 when missing or NA, the filter columns are only
+// required by pbp_ingest (data.R's cuts on game time and season type)
+enum PBPColumn {
+    PLAY_TYPE, DOWN, YDSTOGO, YARDLINE_100, YARDS_GAINED,   // required
+    QB_SCRAMBLE, FUMBLE_LOST, RETURN_YARDS, INTERCEPTION, AIR_YARDS, RUSH_TOUCHDOWN, PASS_TOUCHDOWN,
+    GAME_SECONDS_REMAINING, SEASON_TYPE,                    // filters
+    NUM_PBP_COLUMNS
+};
+const int NUM_REQUIRED_COLUMNS = 5;
+const int FIRST_FILTER_COLUMN = GAME_SECONDS_REMAINING;
+const char* const pbp_column_names[NUM_PBP_COLUMNS] = {
+    "play_type", "down", "ydstogo", "yardline_100", "yards_gained",
+    "qb_scramble", "fumble_lost", "return_yards", "interception", "air_yards", "rush_touchdown", "pass_touchdown",
+    "game_seconds_remaining", "season_type"
+};
+
+// PBPColumn fields (unquoted), then any extra key fields (as written)
+typedef std::vector<std::string_view> PlayFields;
+
+// Splits a line on commas outside quotes (fields with embedded newlines are not supported), keeping the
+// fields whose column is wanted: column_slot[c] is the slot of CSV column c in fields, or -1
+inline void split_fields(std::string_view line, const std::vector<int>& column_slot, PlayFields& fields) {
+    std::fill(fields.begin(), fields.end(), std::string_view());
+    size_t start = 0;
+    bool quoted = false;
+    size_t column = 0;
+    for (size_t i = 0; i <= line.size() && column < column_slot.size(); i++) {
+        if (i < line.size()) {
+            char c = line[i];
+            if (c == '"') quoted = !quoted;
+            if (c != ',' || quoted) continue;
+        }
+        if (column_slot[column] >= 0) {
+            std::string_view field = line.substr(start, i - start);
+            if (column_slot[column] < NUM_PBP_COLUMNS && field.size() >= 2 && field.front() == '"') {
+                field = field.substr(1, field.size() - 2);
+            }
+            fields[column_slot[column]] = field;
+        }
+        column++;
+        start = i + 1;
+    }
+}
+
+// Number in a field, false for NA or empty
+inline bool parse_number(std::string_view field, double& value) {
+    if (field.empty()) return false;
+    auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+    return result.ec == std::errc();
+}
+
+inline int flag(std::string_view field) {
+    double value;
+    return (parse_number(field, value) && value != 0) ? 1 : 0;
+}
+
+inline int yards(std::string_view field) {
+    double value;
+    return parse_number(field, value) ? (int)std::lround(value) : 0;
+}
+
+// A run or pass with its outcome in the cdf_data encoding; down, distance and yardline are 0 when NA
+struct EncodedPlay {
+    bool pass;
+    int down;
+    int distance;
+    int yardline;
+    int outcome;
+};
+
+// Encodes a row with the same mutations rscripts/data.R applies to its samples (fumbles lost -1100 less the
+// return, interceptions -2100 less the return plus the air yards, touchdowns +10)
+// Returns false unless the row is a run or pass with its yards gained; the state is left for the caller to check
+inline bool encode_play(const PlayFields& fields, EncodedPlay& play) {
+    bool scramble = flag(fields[QB_SCRAMBLE]);
+    bool run = fields[PLAY_TYPE] == "run" && !scramble;
+    play.pass = fields[PLAY_TYPE] == "pass" || (fields[PLAY_TYPE] == "run" && scramble);
+    if (!run && !play.pass) return false;
+
+    double gained;
+    if (!parse_number(fields[YARDS_GAINED], gained)) return false;
+    double down, distance, yardline;
+    play.down = parse_number(fields[DOWN], down) ? (int)down : 0;
+    play.distance = parse_number(fields[YDSTOGO], distance) ? (int)distance : 0;
+    play.yardline = parse_number(fields[YARDLINE_100], yardline) ? (int)yardline : 0;
+
+    play.outcome = (int)std::lround(gained);
+    if (flag(fields[FUMBLE_LOST])) play.outcome = -1100 - yards(fields[RETURN_YARDS]) + play.outcome;
+    if (play.pass && flag(fields[INTERCEPTION])) play.outcome = -2100 - yards(fields[RETURN_YARDS]) + yards(fields[AIR_YARDS]);
+    if (flag(fields[RUSH_TOUCHDOWN]) || (play.pass && flag(fields[PASS_TOUCHDOWN]))) play.outcome = 10 + play.outcome;
+    return true;
+}
+
+// Finds the wanted columns and the key columns in the header, false if a required or key column is missing
+// (the filter columns are required too if filters is set)
+inline bool map_columns(std::string_view header, const std::vector<std::string>& keys, bool filters,
+                        std::vector<int>& column_slot) {
+    column_slot.clear();
+    std::vector<bool> found(NUM_PBP_COLUMNS + keys.size(), false);
+    size_t start = 0;
+    while (start <= header.size()) {
+        size_t end = header.find(',', start);
+        if (end == std::string_view::npos) end = header.size();
+        std::string_view name = header.substr(start, end - start);
+        if (name.size() >= 2 && name.front() == '"') name = name.substr(1, name.size() - 2);
+
+        int slot = -1;
+        for (size_t c = 0; c < found.size() && slot < 0; c++) {
+            // Both arms as views: a const char* and string ternary would be a temporary string
+            std::string_view wanted = (c < NUM_PBP_COLUMNS) ? std::string_view(pbp_column_names[c])
+                                                            : std::string_view(keys[c - NUM_PBP_COLUMNS]);
+            if (!found[c] && name == wanted) {
+                slot = c;
+                found[c] = true;
+            }
+        }
+        column_slot.push_back(slot);
+        start = end + 1;
+    }
+
+    // Columns past the last wanted one are never split
+    while (!column_slot.empty() && column_slot.back() < 0) column_slot.pop_back();
+
+    for (size_t c = 0; c < found.size(); c++) {
+        bool required = c < NUM_REQUIRED_COLUMNS || c >= NUM_PBP_COLUMNS || (filters && (int)c >= FIRST_FILTER_COLUMN);
+        if (!found[c] && required) {
+            std::cerr << "Play-by-play file has no " << ((c < NUM_PBP_COLUMNS) ? pbp_column_names[c] : keys[c - NUM_PBP_COLUMNS])
+                      << " column" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+// Trailing carriage return of a CRLF file
+inline std::string_view trim_line(const char* begin, const char* end) {
+    if (end > begin && end[-1] == '\r') end--;
+    return std::string_view(begin, end - begin);
+}
+
+// Reads a CSV in READ_BYTES blocks: on_header gets the first line (false stops the read), then on_block gets each
+// block's complete non-empty lines, which stay valid until it returns. Only a block and one partial line are ever
+// in memory. Progress is reported in MB read
+inline bool stream_csv(const std::string& filename, const std::function<bool(std::string_view)>& on_header,
+                       const std::function<void(const std::vector<std::string_view>&)>& on_block, Progress& progress) {
+    FILE* input = fopen(filename.c_str(), "rb");
+    if (!input) {
+        std::cerr << "Error opening file: " << filename << std::endl;
+        return false;
+    }
+    fseek(input, 0, SEEK_END);
+    long total_bytes = ftell(input);
+    fseek(input, 0, SEEK_SET);
+
+    std::vector<char> buffer;
+    std::vector<std::string_view> lines;
+    bool header_done = false;
+    long bytes_read = 0;
+    size_t kept = 0;   // bytes of an unfinished line carried over from the last block
+
+    while (true) {
+        buffer.resize(kept + READ_BYTES);
+        size_t got = fread(buffer.data() + kept, 1, READ_BYTES, input);
+        bytes_read += got;
+        size_t size = kept + got;
+        bool last = got == 0;
+        if (last && size > 0 && buffer[size - 1] != '\n') buffer.insert(buffer.begin() + size++, '\n');  // no final newline
+
+        const char* begin = buffer.data();
+        const char* end = begin + size;
+        const char* line = begin;
+        lines.clear();
+        while (line < end) {
+            const char* newline = (const char*)memchr(line, '\n', end - line);
+            if (!newline) break;
+            std::string_view text = trim_line(line, newline);
+            line = newline + 1;
+
+            if (!header_done) {
+                if (!on_header(text)) {
+                    fclose(input);
+                    return false;
+                }
+                header_done = true;
+                continue;
+            }
+            if (!text.empty()) lines.push_back(text);
+        }
+
+        on_block(lines);
+        progress.report("MB", bytes_read >> 20, total_bytes >> 20);
+
+        kept = end - line;
+        memmove(buffer.data(), line, kept);
+        if (last) break;
+    }
+    fclose(input);
+    return true;
+}
+
+#endif
@@ -0,0 +1,220 @@
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "sim_engine.hpp"
+#include "pbp_csv.hpp"
+#include "counter_rng.hpp"
+
+using namespace std;
+
+// Builds the distr_data sample files from local play-by-play exports, in place of rscripts/data.R
+// Each CSV is streamed in blocks; a block's lines are split across the thread pool, every run and pass that passes
+// data.R's filters is encoded the way data.R encodes it, and the per-chunk samples are appended in chunk order, so
+// the samples keep the file's row order for any thread count. Memory is the samples plus one block
+// Gaps are then filled as data.R fills them (neighbouring distances, then the bin's pool, then padding to the
+// threshold), drawing from a counter-based stream per file so the output is reproducible
+
+// data.R's filters: regular season, at least five minutes left
+const double MIN_SECONDS_REMAINING = 300;
+
+int num_keys() { return 4 * MAX_DISTANCE; }
+
+// Samples of every (play type, bin, down, distance), and every (play type, bin) pool of samples at any down and
+// distance (data.R's fallback pool)
+struct SampleSet {
+    vector<vector<int32_t>> keyed = vector<vector<int32_t>>(play_types.size() * yardline_bins.size() * num_keys());
+    vector<vector<int32_t>> pools = vector<vector<int32_t>>(play_types.size() * yardline_bins.size());
+
+    static int file_index(bool pass, int bin) {
+        return (pass ? 1 : 0) * yardline_bins.size() + bin;   // play_types is {"rush", "pass"}
+    }
+
+    static int key_index(int file, int down, int distance) {
+        return file * num_keys() + (distance - 1) * 4 + (down - 1);  // expand.grid order, down fastest
+    }
+
+    void append(const SampleSet& other) {
+        for (size_t i = 0; i < keyed.size(); i++) keyed[i].insert(keyed[i].end(), other.keyed[i].begin(), other.keyed[i].end());
+        for (size_t i = 0; i < pools.size(); i++) pools[i].insert(pools[i].end(), other.pools[i].begin(), other.pools[i].end());
+    }
+
+    void clear() {
+        for (auto& samples : keyed) samples.clear();
+        for (auto& samples : pools) samples.clear();
+    }
+};
+
+// Adds a block's qualifying plays to samples
+void ingest_lines(const vector<string_view>& lines, size_t begin, size_t end, const vector<int>& column_slot,
+                  const vector<int>& yardline_mapping, SampleSet& samples) {
+    PlayFields fields(NUM_PBP_COLUMNS);
+    EncodedPlay play;
+    for (size_t i = begin; i < end; i++) {
+        split_fields(lines[i], column_slot, fields);
+        double seconds;
+        if (fields[SEASON_TYPE] != "REG" || !parse_number(fields[GAME_SECONDS_REMAINING], seconds) ||
+            seconds < MIN_SECONDS_REMAINING) {
+            continue;
+        }
+        if (!encode_play(fields, play) || play.yardline < 1 || play.yardline > NUM_YARDLINES) continue;
+
+        int file = SampleSet::file_index(play.pass, yardline_mapping[play.yardline]);
+        samples.pools[file].push_back(play.outcome);
+        if (play.down >= 1 && play.down <= 4 && play.distance >= 1 && play.distance <= MAX_DISTANCE) {
+            samples.keyed[SampleSet::key_index(file, play.down, play.distance)].push_back(play.outcome);
+        }
+    }
+}
+
+// size draws with replacement, like R's sample(from, size, replace = TRUE)
+vector<int32_t> resample(const vector<int32_t>& from, int size, CounterRNG& rng) {
+    vector<int32_t> drawn(size);
+    for (int i = 0; i < size; i++) drawn[i] = from[rng.below(from.size())];
+    return drawn;
+}
+
+// data.R's gap filling for one file's keys, in the expand.grid order its passes walk: a missing key takes its
+// neighbouring distances' samples (resampled up to the threshold if there are fewer), then any key still missing
+// draws from the pool (zeros if the pool is empty too), and every key short of the threshold is resampled up to it
+void fill_gaps(vector<vector<int32_t>*>& keys, const vector<int32_t>& pool, int threshold, CounterRNG& rng) {
+    for (int k = 0; k < num_keys(); k++) {
+        if (!keys[k]->empty()) continue;
+        int distance = k / 4 + 1;
+        vector<int32_t> neighbours;
+        if (distance > 1) neighbours = *keys[k - 4];
+        if (distance < MAX_DISTANCE) neighbours.insert(neighbours.end(), keys[k + 4]->begin(), keys[k + 4]->end());
+        if (neighbours.empty()) continue;
+        *keys[k] = ((int)neighbours.size() < threshold) ? resample(neighbours, threshold, rng) : neighbours;
+    }
+    for (int k = 0; k < num_keys(); k++) {
+        if (!keys[k]->empty()) continue;
+        *keys[k] = pool.empty() ? vector<int32_t>(threshold, 0) : resample(pool, threshold, rng);
+    }
+    for (int k = 0; k < num_keys(); k++) {
+        if ((int)keys[k]->size() < threshold) *keys[k] = resample(*keys[k], threshold, rng);
+    }
+}
+
+// Writes one distr_data file laid out like data.R's write_json(pretty = TRUE), but with every key in key_index order:
+// data.R writes the keys it observed down by down, then the filled ones. Readers look keys up by name
+bool write_samples_json(const string& filename, const vector<vector<int32_t>*>& keys) {
+    string out = "{\n";
+    for (int k = 0; k < num_keys(); k++) {
+        out += "  \"" + to_string(k % 4 + 1) + "-" + to_string(k / 4 + 1) + "\": [";
+        for (size_t i = 0; i < keys[k]->size(); i++) {
+            if (i > 0) out += ", ";
+            out += to_string((*keys[k])[i]);
+        }
+        out += (k + 1 < num_keys()) ? "],\n" : "]\n}\n";
+    }
+
+    ofstream json(filename);
+    if (!json.is_open()) {
+        cerr << "Error opening file: " << filename << endl;
+        return false;
+    }
+    json << out;
+    return bool(json);
+}
+
+int main(int argc, char* argv[]) {
+
+    // Optional flags: --threshold N is the minimum samples per key (default 20, data.R's argument), --threads N splits
+    // each block across N threads (default every core; the output does not depend on it), --seed S seeds the gap
+    // filling draws, --progress draws a progress line on stderr
+    Progress progress;
+    int threshold = 20;
+    int num_threads = max(1u, thread::hardware_concurrency());
+    uint64_t seed = 1;
+    vector<string> args;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--threshold" && i + 1 < argc) {
+            threshold = stoi(argv[++i]);
+        } else if (arg == "--threads" && i + 1 < argc) {
+            num_threads = stoi(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = stoull(argv[++i]);
+        } else if (arg == "--progress") {
+            progress.use_console();
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if (args.size() < 2) {
+        cout << "Need to input an output directory and one or more play-by-play CSVs: " <<
+                "(./pbp_ingest.out distr_data pbp_2023.csv [pbp_2024.csv ...] [--threshold N] [--threads N] [--seed S] [--progress])" << endl;
+        return 1;
+    }
+
+    string distr_dir = args[0];
+    vector<int> yardline_mapping;
+    generateYardlineMapping(yardline_mapping);
+
+    auto start = chrono::high_resolution_clock::now();
+
+    // One pass over every file; each block is split into one contiguous chunk per thread, appended in order
+    ThreadPool pool(num_threads);
+    SampleSet samples;
+    vector<SampleSet> chunks(pool.size());
+    for (size_t f = 1; f < args.size(); f++) {
+        vector<int> column_slot;
+        long rows = 0;
+        auto read_header = [&](string_view header) {
+            return map_columns(header, {}, true, column_slot);
+        };
+        auto ingest_block = [&](const vector<string_view>& lines) {
+            int num_chunks = chunks.size();
+            pool.parallel_for(num_chunks, [&](int begin, int end) {
+                for (int c = begin; c < end; c++) {
+                    chunks[c].clear();
+                    ingest_lines(lines, lines.size() * c / num_chunks, lines.size() * (c + 1) / num_chunks, column_slot,
+                                 yardline_mapping, chunks[c]);
+                }
+            });
+            for (const SampleSet& chunk : chunks) samples.append(chunk);
+            rows += lines.size();
+        };
+        if (!stream_csv(args[f], read_header, ingest_block, progress)) {
+            return 1;
+        }
+        cout << "Read " << rows << " plays from " << args[f] << endl;
+    }
+
+    long kept = 0;
+    for (const auto& file_pool : samples.pools) kept += file_pool.size();
+    cout << "Kept " << kept << " regular season runs and passes" << endl;
+
+    // Gap filling and output, one file per play type and bin
+    error_code error;
+    filesystem::create_directories(distr_dir, error);
+    int num_files = samples.pools.size();
+    vector<char> failed(num_files, 0);
+    pool.parallel_for(num_files, [&](int begin, int end) {
+        for (int file = begin; file < end; file++) {
+            vector<vector<int32_t>*> keys(num_keys());
+            for (int k = 0; k < num_keys(); k++) keys[k] = &samples.keyed[file * num_keys() + k];
+            CounterRNG rng(seed, file);
+            fill_gaps(keys, samples.pools[file], threshold, rng);
+
+            string filename = distr_dir + "/" + play_types[file / yardline_bins.size()] + "_distributions_yl" +
+                              yardline_bins[file % yardline_bins.size()] + ".json";
+            if (!write_samples_json(filename, keys)) failed[file] = 1;
+        }
+    });
+    if (count(failed.begin(), failed.end(), 1) > 0) {
+        return 1;
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    cout << "Samples saved to: " << distr_dir << endl;
+    cout << "Execution time: " << chrono::duration<double>(end - start).count() << " seconds" << endl;
+    return 0;
+}
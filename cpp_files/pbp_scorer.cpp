@@ -0,0 +1,147 @@
+#include <iostream>
+#include <vector>
+#include <array>
+#include <string>
+#include <string_view>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include "sim_engine.hpp"
+#include "pbp_csv.hpp"
+
+using namespace std;
+
+// Batch EPA scorer for play-by-play exports (the nflfastR columns rscripts/data.R reads)
+// Streams the CSV in large blocks; each block's runs and passes are encoded the way data.R encodes samples,
+// then resolved to EP and EPA against a converged table: one gather for the EPs before the snap and one pass
+// through play_result (the simulators' transition logic) for the EPs after. Rows are written back unchanged
+// with sim_ep and sim_epa appended (NA for plays that are not scored runs or passes), or with --keys only the
+// named key columns (e.g. game_id,play_id) and the two EP columns, which is far less to write
+
+// State and outcome (cdf_data encoding) of a play
+// Returns false unless the row is a run or pass from a state on the grid, with an outcome that decodes
+bool encode_state(const PlayFields& fields, int& index, int& distance, int& outcome) {
+    EncodedPlay play;
+    if (!encode_play(fields, play)) return false;
+    if (play.down < 1 || play.down > 4 || play.yardline < 1 || play.yardline > NUM_YARDLINES || play.distance < 1 ||
+        play.distance > play.yardline || !play_in_range(play.outcome)) {
+        return false;
+    }
+    index = table_state(play.down, play.distance, play.yardline);
+    distance = play.distance;
+    outcome = play.outcome;
+    return true;
+}
+
+// Scores one block of complete lines and appends them to the output
+// keys: number of --keys columns, 0 to write whole rows
+void score_block(const EPTable& table, const vector<string_view>& lines, const vector<int>& column_slot, int keys,
+                 CSVWriter& file, long& scored) {
+    size_t n = lines.size();
+    vector<int> index(n), distance(n), outcome(n);
+    vector<double> ep(n), epa(n);
+    PlayFields fields(NUM_PBP_COLUMNS + keys);
+    vector<string_view> key_fields(n * keys);
+
+    for (size_t i = 0; i < n; i++) {
+        split_fields(lines[i], column_slot, fields);
+        if (!encode_state(fields, index[i], distance[i], outcome[i])) index[i] = -1;
+        for (int k = 0; k < keys; k++) key_fields[i * keys + k] = fields[NUM_PBP_COLUMNS + k];
+    }
+
+    const double* table_ep = table.states.max.data();
+    for (size_t i = 0; i < n; i++) {
+        ep[i] = (index[i] >= 0) ? table_ep[index[i]] : NAN;
+    }
+    for (size_t i = 0; i < n; i++) {
+        epa[i] = (index[i] >= 0) ? table_epa(table, index[i], distance[i], outcome[i]) : NAN;
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        if (keys == 0) file.field(lines[i]);
+        for (int k = 0; k < keys; k++) file.field(key_fields[i * keys + k]);
+        if (index[i] < 0) {
+            file.field(string_view("NA"));
+            file.field(string_view("NA"));
+        } else {
+            file.field(ep[i]);
+            file.field(epa[i]);
+            scored++;
+        }
+        file.end_row();
+    }
+}
+
+int main(int argc, char* argv[]) {
+
+    // Optional flags: --keys a,b writes only those columns before sim_ep and sim_epa, --full-precision writes EPs
+    // so they read back exactly, --progress draws a progress line on stderr
+    Progress progress;
+    bool full_precision = false;
+    vector<string> keys;
+    vector<string> args;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--keys" && i + 1 < argc) {
+            stringstream ss(argv[++i]);
+            string key;
+            while (getline(ss, key, ',')) keys.push_back(key);
+        } else if (arg == "--full-precision") {
+            full_precision = true;
+        } else if (arg == "--progress") {
+            progress.use_console();
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if (args.size() != 3) {
+        cout << "Need to input an EP table, a play-by-play CSV and an output file: " <<
+                "(./pbp_scorer.out final_eps.csv pbp.csv scored_pbp.csv [--keys game_id,play_id] [--full-precision] [--progress])" << endl;
+        return 1;
+    }
+
+    EPTable table;
+    if (!loadEPTable(args[0], table)) {
+        return 1;
+    }
+
+    CSVWriter file(full_precision);
+    if (!file.open(args[2])) {
+        return 1;
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+
+    vector<int> column_slot;
+    long rows = 0;
+    long scored = 0;
+    auto write_header = [&](string_view header) {
+        if (!map_columns(header, keys, false, column_slot)) return false;
+        if (keys.empty()) file.field(header);
+        for (const string& key : keys) file.field(key);
+        file.field(string_view("sim_ep"));
+        file.field(string_view("sim_epa"));
+        file.end_row();
+        return true;
+    };
+    auto score_lines = [&](const vector<string_view>& lines) {
+        score_block(table, lines, column_slot, keys.size(), file, scored);
+        rows += lines.size();
+    };
+    if (!stream_csv(args[1], write_header, score_lines, progress)) {
+        return 1;
+    }
+
+    if (!file.close()) {
+        cerr << "Error writing file: " << args[2] << endl;
+        return 1;
+    }
+
+    double seconds = chrono::duration<double>(chrono::high_resolution_clock::now() - start).count();
+    cout << "Scored " << scored << " of " << rows << " plays in " << seconds << " seconds ("
+         << rows / seconds << " rows/s)" << endl;
+    cout << "Scored CSV saved to: " << args[2] << endl;
+
+    return 0;
+}
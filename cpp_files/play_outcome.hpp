@@ -0,0 +1,63 @@
+#ifndef PLAY_OUTCOME_HPP
+#define PLAY_OUTCOME_HPP
+
+#include <cstdint>
+
+// Sampled results as typed records, decoded once when the samples are loaded. The sample files (distr_data,
+// cdf_data, the CDF bundle, punt_net_yards.json) keep the encoding rscripts/data.R writes:
+//   runs and passes  yards gained (+10 on a touchdown), a lost fumble -1100 plus the net yards, an
+//                    interception -2100 plus the net yards (air yards less the return)
+//   punts            net yards, a return touchdown below -1000, a recovered muff 1000 plus the yards
+// Nothing past the loaders reads the raw values
+
+enum PlayKind : uint8_t { PLAY_GAIN, PLAY_FUMBLE_LOST, PLAY_INTERCEPTION };
+
+// A run or pass: the yards gained (past the goal line on a touchdown), or for a turnover the net yards towards the
+// goal line at the spot the other team takes over. The encoding only keeps a turnover's net yards, not the return
+struct PlayOutcome {
+    int16_t yards;
+    PlayKind kind;
+
+    bool turnover() const { return kind != PLAY_GAIN; }
+};
+
+inline PlayOutcome decode_play(int32_t val) {
+    if (val < -2000) return PlayOutcome{int16_t(val + 2100), PLAY_INTERCEPTION};
+    if (val < -1000) return PlayOutcome{int16_t(val + 1100), PLAY_FUMBLE_LOST};
+    return PlayOutcome{int16_t(val), PLAY_GAIN};
+}
+
+// True if val decodes without overflowing PlayOutcome::yards
+inline bool play_in_range(int32_t val) {
+    return val >= -2100 - 32768 && val <= 32767;
+}
+
+enum PuntKind : uint8_t {
+    PUNT_RECEIVED,         // the other team has first down at yardline
+    PUNT_TOUCHBACK,
+    PUNT_RETURN_TD,
+    PUNT_MUFF_RECOVERED,   // the kicking team keeps the ball, first down at yardline
+    PUNT_MUFF_TD
+};
+
+// A punt, resolved against the yardline it was kicked from
+struct PuntOutcome {
+    int16_t yardline;
+    PuntKind kind;
+};
+
+inline PuntOutcome decode_punt(int32_t val, int yardline) {
+    if (val < -1000) return PuntOutcome{0, PUNT_RETURN_TD};
+    if (val > 1000) {
+        int new_yardline = yardline - (val - 1000);
+        return (new_yardline <= 0) ? PuntOutcome{0, PUNT_MUFF_TD} : PuntOutcome{int16_t(new_yardline), PUNT_MUFF_RECOVERED};
+    }
+    if (yardline - val <= 0) return PuntOutcome{0, PUNT_TOUCHBACK};
+    int received = 100 - (yardline - val);
+    // A few recorded punts end on or behind the kicking team's own 1; they have always been scored as return
+    // touchdowns
+    if (received <= 1) return PuntOutcome{0, PUNT_RETURN_TD};
+    return PuntOutcome{int16_t(received), PUNT_RECEIVED};
+}
+
+#endif
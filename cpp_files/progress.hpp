@@ -0,0 +1,81 @@
+#ifndef PROGRESS_HPP
+#define PROGRESS_HPP
+
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include "csv_writer.hpp"
+#include "state_table.hpp"
+
+// Progress and telemetry for a run, quiet unless asked for:
+//   a progress callback, rate limited so fast sweeps do not flood the console
+//   an optional machine-readable trace of every state after every sweep, at full precision
+class Progress {
+public:
+    using Callback = std::function<void(const std::string& stage, long done, long total)>;
+
+    Progress() : trace(true) {}
+    ~Progress() { close_trace(); }
+
+    void set_callback(Callback cb, double min_interval_seconds = 0.1) {
+        callback = cb;
+        min_interval = min_interval_seconds;
+    }
+
+    // Console progress line on stderr, redrawn in place
+    void use_console() {
+        set_callback([](const std::string& stage, long done, long total) {
+            std::cerr << "\r" << stage << " " << done << "/" << total << "   " << (done == total ? "\n" : "") << std::flush;
+        });
+    }
+
+    // Calls the callback at most once per interval, but always for the final step
+    void report(const std::string& stage, long done, long total) {
+        if (!callback) return;
+        auto now = std::chrono::steady_clock::now();
+        if (done != total && reported && std::chrono::duration<double>(now - last_report).count() < min_interval) return;
+        reported = true;
+        last_report = now;
+        callback(stage, done, total);
+    }
+
+    bool open_trace(const std::string& filename) {
+        if (!trace.open(filename)) return false;
+        trace.line("Sweep,Down,Distance,Yardline,Run_EP,Pass_EP,Kick_EP,Punt_EP,EP,Opt_Choice");
+        return true;
+    }
+
+    bool tracing() const { return trace.is_open(); }
+
+    // Appends every computed state of the table, tagged with the sweep number
+    void trace_sweep(int sweep, const StateTable& table) {
+        if (!trace.is_open()) return;
+        for (int index = 0; index < NUM_STATES; index++) {
+            if (!table.computed[index]) continue;
+            int yardline = index % NUM_YARDLINES + 1;
+            int distance = (index / NUM_YARDLINES) % MAX_DISTANCE + 1;
+            int down = index / (NUM_YARDLINES * MAX_DISTANCE) + 1;
+            trace.field(sweep);
+            trace.field(down);
+            trace.field(distance);
+            trace.field(yardline);
+            write_state_fields(trace, table, index);
+            trace.end_row();
+        }
+    }
+
+    void close_trace() {
+        if (!trace.close()) std::cerr << "Error writing trace file" << std::endl;
+    }
+
+private:
+    Callback callback;
+    double min_interval = 0.1;
+    bool reported = false;
+    std::chrono::steady_clock::time_point last_report;
+
+    CSVWriter trace;
+};
+
+#endif
@@ -0,0 +1,141 @@
+#ifndef RESULT_CACHE_HPP
+#define RESULT_CACHE_HPP
+
+#include <charconv>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include <unistd.h>
+#include "cdf_store.hpp"
+
+// Bump when a change to the engine changes the EPs a run produces, so older cached tables stop matching
+const int RESULT_CACHE_VERSION = 2;
+
+// On-disk cache of finished EP tables (--cache DIR), keyed by everything a table depends on: the contents of the
+// inputs, the model constants and the run's parameters. Each part is one "name=value" line of a recipe, the key
+// is the recipe's hash, and an entry is DIR/<key>.csv plus DIR/<key>.key holding the recipe, which a hit must match
+// line for line (so a hash collision is a miss, and the .key file says what a cached table was built from).
+// A run's convergence report (--report) is kept with its table as DIR/<key>.report.csv
+class ResultCache {
+public:
+    // Creates the directory if needed; the cache stays off if it cannot
+    bool use_directory(const std::string& dir) {
+        std::error_code error;
+        std::filesystem::create_directories(dir, error);
+        if (error) {
+            std::cerr << "Error creating cache directory: " << dir << std::endl;
+            return false;
+        }
+        directory = dir;
+        return true;
+    }
+
+    bool enabled() const { return !directory.empty(); }
+
+    void add(const std::string& name, const std::string& value) {
+        recipe += name + "=" + value + "\n";
+    }
+
+    // Shortest text that reads back to the same double, so keys only match on identical values
+    void add(const std::string& name, double value) {
+        char text[32];
+        auto result = std::to_chars(text, text + sizeof(text), value);
+        add(name, std::string(text, result.ptr - text));
+    }
+
+    void add(const std::string& name, int value) { add(name, std::to_string(value)); }
+
+    void add_hash(const std::string& name, uint64_t hash) {
+        std::ostringstream text;
+        text << std::hex << hash;
+        add(name, text.str());
+    }
+
+    // Plain data (EPs, decision counts) by the hash of its bytes
+    template <typename T>
+    void add(const std::string& name, const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable<T>::value, "hashed as raw bytes");
+        add_hash(name, fnv1a_64(reinterpret_cast<const unsigned char*>(values.data()), values.size() * sizeof(T)));
+    }
+
+    std::string key() const {
+        std::ostringstream text;
+        text << std::hex << fnv1a_64(reinterpret_cast<const unsigned char*>(recipe.data()), recipe.size());
+        return text.str();
+    }
+
+    // Copies a cached table to target_file, and its report to report_file if one is given; false on a miss, which
+    // includes an entry stored without the report asked for, so the run solves and writes it
+    bool fetch(const std::string& target_file, const std::string& report_file = "") const {
+        if (!enabled()) return false;
+        std::string entry = directory + "/" + key();
+        std::ifstream stored(entry + ".key");
+        if (!stored.is_open()) return false;
+        std::ostringstream stored_recipe;
+        stored_recipe << stored.rdbuf();
+        if (stored_recipe.str() != recipe) return false;
+        if (!report_file.empty() && !std::filesystem::exists(entry + ".report.csv")) return false;
+        if (!copy(entry + ".csv", target_file)) return false;
+        if (!report_file.empty() && !copy(entry + ".report.csv", report_file)) return false;
+        std::cout << "Cache hit: " << entry << ".csv, skipping the solve" << std::endl;
+        if (!report_file.empty()) std::cout << "Convergence report copied to: " << report_file << std::endl;
+        return true;
+    }
+
+    // Saves a finished table, and the report_file written with it if one is given, under the current key; temporary
+    // files renamed into place keep concurrent runs sharing the directory from reading half-written entries
+    void store(const std::string& target_file, const std::string& report_file = "") const {
+        if (!enabled()) return;
+        std::string entry = directory + "/" + key();
+        std::string temp = "." + std::to_string(getpid()) + ".tmp";
+        {
+            std::ofstream file(entry + ".key" + temp);
+            file << recipe;
+            if (!file) {
+                std::cerr << "Error writing file: " << entry << ".key" << std::endl;
+                return;
+            }
+        }
+        if (!copy(target_file, entry + ".csv" + temp)) return;
+        if (!report_file.empty()) {
+            if (!copy(report_file, entry + ".report.csv" + temp)) return;
+            if (std::rename((entry + ".report.csv" + temp).c_str(), (entry + ".report.csv").c_str()) != 0) {
+                std::cerr << "Error writing file: " << entry << ".report.csv" << std::endl;
+                return;
+            }
+        }
+        // The table and report go in first, so a .key file always has them
+        if (std::rename((entry + ".csv" + temp).c_str(), (entry + ".csv").c_str()) != 0 ||
+            std::rename((entry + ".key" + temp).c_str(), (entry + ".key").c_str()) != 0) {
+            std::cerr << "Error writing file: " << entry << ".csv" << std::endl;
+            return;
+        }
+        std::cout << "Cached as: " << entry << ".csv" << std::endl;
+    }
+
+private:
+    std::string directory;
+    std::string recipe = "version=" + std::to_string(RESULT_CACHE_VERSION) + "\n";
+
+    static bool copy(const std::string& from, const std::string& to) {
+        std::ifstream in(from, std::ios::binary);
+        if (!in.is_open()) {
+            std::cerr << "Error opening file: " << from << std::endl;
+            return false;
+        }
+        std::ofstream out(to, std::ios::binary);
+        if (!out.is_open()) {
+            std::cerr << "Error opening file: " << to << std::endl;
+            return false;
+        }
+        out << in.rdbuf();
+        return bool(out);
+    }
+};
+
+#endif
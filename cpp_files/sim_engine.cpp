@@ -0,0 +1,475 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <array>
+#include <sstream>
+#include <charconv>
+#include "json.hpp"
+#include "sim_engine.hpp"
+
+using json = nlohmann::json;
+using namespace std;
+
+// Field Goal Probabilities by yardline position
+const vector<double> fg_prob = {
+    1.0, 0.9875, 1.0, 0.9919, 0.9937, 0.9929, 0.9797, 0.9818, 0.9693, 0.977,
+    0.9479, 0.983, 0.9777, 0.9459, 0.9659, 0.899, 0.92, 0.9167, 0.9347, 0.893,
+    0.9053, 0.8603, 0.7956, 0.822, 0.7885, 0.8, 0.7405, 0.7267, 0.7231, 0.6986,
+    0.7394, 0.7416, 0.7216, 0.6911, 0.6994, 0.7059, 0.6129, 0.5595, 0.6271, 0.5297,
+    0.4935, 0.4548, 0.4136, 0.3697, 0.3230, 0.2735, 0.2211, 0.1655, 0.1069, 0.0450,
+    0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0,
+    0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0,
+    0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0
+};
+
+// Field Goal Probabilities used by the naive simulators
+const vector<double> fg_prob_naive = {
+    1.0, 0.9875, 1.0, 0.9919, 0.9937, 0.9929, 0.9797, 0.9818, 0.9693, 0.977,
+    0.9479, 0.983, 0.9777, 0.9459, 0.9659, 0.899, 0.92, 0.9167, 0.9347, 0.893,
+    0.9053, 0.8603, 0.7956, 0.822, 0.7885, 0.8, 0.7405, 0.7267, 0.7231, 0.6986,
+    0.7394, 0.7416, 0.7216, 0.6911, 0.6994, 0.7059, 0.6129, 0.5595, 0.6271, 0.5833,
+    0.5714, 0.4667, 0.4167, 0.5556, 0.375, 0.3333, 0.2, 0.05, 0.01, 0.005,
+    0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0,
+    0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0,
+    0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0
+};
+
+
+// Function to generate mapping from yardline (1-99) to index of yardline_bins
+void generateYardlineMapping(vector<int>& yardline_mapping) {
+    yardline_mapping.resize(100, -1); // Initialize with -1 for safety
+
+    for (size_t index = 0; index < yardline_bins.size(); index++) {
+        string bin = yardline_bins[index];
+
+        // Handle individual yardline bins (e.g., "1", "2", ...)
+        if (bin.find('-') == string::npos) {
+            int yardline = stoi(bin);
+            yardline_mapping[yardline] = index;
+        } 
+        // Handle grouped bins (e.g., "21-23", "24-27", ...)
+        else {
+            stringstream ss(bin);
+            int start, end;
+            char dash;
+            ss >> start >> dash >> end;
+            
+            for (int yardline = start; yardline <= end; yardline++) {
+                yardline_mapping[yardline] = index;
+            }
+        }
+    }
+}
+
+
+// Lists the rush/pass CDFs that states on the grid need but the data does not have. A missing play counts as
+// having no outcomes (0 EPA), so a long list usually means the wrong cdf_data or a MAX_DISTANCE past its keys
+int reportMissingCDFs(const CDFStore& cdf_store, const vector<int>& yardline_mapping) {
+    const int SHOWN = 10;
+    int missing = 0;
+    int states = 0;
+    for (size_t play = 0; play < play_types.size(); play++) {
+        for (size_t bin = 0; bin < yardline_bins.size(); bin++) {
+            for (int down = 1; down <= 4; down++) {
+                for (int distance = 1; distance <= MAX_DISTANCE; distance++) {
+                    if (cdf_store.contains(play, bin, down, distance)) continue;
+
+                    int bin_states = 0;
+                    for (int yardline = distance; yardline <= NUM_YARDLINES; yardline++) {
+                        if (yardline_mapping[yardline] == (int)bin) bin_states++;
+                    }
+                    if (bin_states == 0) continue;
+
+                    if (missing < SHOWN) {
+                        cerr << "Missing CDF: " << play_types[play] << " " << down << "-" << distance << " in bin "
+                             << yardline_bins[bin] << " (" << bin_states << " states)" << endl;
+                    }
+                    missing++;
+                    states += bin_states;
+                }
+            }
+        }
+    }
+    if (missing > SHOWN) {
+        cerr << "... and " << missing - SHOWN << " more" << endl;
+    }
+    if (missing > 0) {
+        cerr << missing << " CDFs missing for " << states << " state plays, which count as having no outcomes" << endl;
+    }
+    return missing;
+}
+
+void loadPriorData(const string& filename, vector<double>& data) {
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Error opening file: " << filename << endl;
+        return;
+    }
+
+    // Resize vector to store values for yardline 1 to 99
+    data.assign(99, 0.0);  
+
+    string line;
+    getline(file, line);  // Skip header
+
+    while (getline(file, line)) {
+        stringstream ss(line);
+        int down, distance, yardline, opt_choice;
+        double run_ep, pass_ep, kick_ep, punt_ep, max_ep;
+        char comma;
+    
+        ss >> down >> comma >> distance >> comma >> yardline >> comma
+           >> run_ep >> comma >> pass_ep >> comma >> kick_ep >> comma
+           >> punt_ep >> comma >> max_ep >> comma >> opt_choice;
+    
+        // Store the value only if down == 1 and the specified conditions are met
+        if (down == 1 && yardline <= NUM_YARDLINES && ((distance == 10 && yardline >= 10) || (distance == yardline && yardline < 10))) {
+            int index = yardline - 1;  // Convert 1-based yardline to 0-based index
+            data[index] = max_ep;
+        }
+    }    
+    
+
+    file.close();
+    cout << "Successfully loaded prior EP data for " 
+         << count_if(data.begin(), data.end(), [](double v) { return v != 0.0; }) 
+         << " yardlines." << endl;
+}
+
+
+void loadPriorDataFromCSV(const string& filename, StateTable& table) {
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Error opening file: " << filename << endl;
+        return;
+    }
+
+    string line;
+    getline(file, line);  // Skip header
+
+    int count = 0;
+
+    while (getline(file, line)) {
+        stringstream ss(line);
+        int down, ydstogo, yardline;
+        double run, pass, kick, punt, max;
+        char comma;
+
+        // Read integers using ss >> ... >> comma >> ...
+        ss >> down >> comma
+           >> ydstogo >> comma
+           >> yardline >> comma
+           >> run >> comma
+           >> pass >> comma
+           >> kick >> comma
+           >> punt >> comma
+           >> max;
+
+        if (!ss || down < 1 || down > 4 || ydstogo < 1 || yardline < 1 || yardline > NUM_YARDLINES) continue;  // malformed
+        if (ydstogo > MAX_DISTANCE) continue;  // off the state grid
+
+        table.prior[state_index(down, ydstogo, yardline)] = max;
+        count++;
+    }
+
+    file.close();
+    cout << "Successfully loaded prior data." << endl;
+}
+
+
+void loadPuntNetYards(vector<vector<int>>& puntYards, const string& filename) {
+    // Open JSON file
+    ifstream file(filename);
+    if (!file) {
+        cerr << "Error opening file: " << filename << endl;
+        return;
+    }
+
+    json jsonData;
+    file >> jsonData; // Parse JSON
+    file.close();
+
+    // Resize vector to ensure it has 99 elements (index 0 = yardline 1)
+    puntYards.resize(99);
+
+    // Process JSON data
+    for (auto& [key, value] : jsonData.items()) {
+        int yardline = stoi(key);
+        if (yardline >= 1 && yardline <= 99) {
+            int index = yardline - 1; // Convert yardline to 0-based index
+            vector<int> yards = value.get<vector<int>>(); // Extract values
+
+            // If the yardline vector has fewer than 10 elements, make it empty
+            if (yards.size() < 10) {
+                yards.clear();
+            }
+
+            puntYards[index] = yards;
+        }
+    }
+}
+
+
+void loadDecisionData(const string& filename, vector<DECISION_ENTRY>& decision_data,
+                      vector<DECISION_ENTRY>* fourth_beyond_grid) {
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Error opening file: " << filename << endl;
+        return;
+    }
+
+    string line;
+    getline(file, line);  // Skip header
+
+    decision_data.assign(NUM_STATES, DECISION_ENTRY{0, 0, 0, 0});
+    if (fourth_beyond_grid) fourth_beyond_grid->assign(max(0, NUM_YARDLINES - MAX_DISTANCE) * NUM_YARDLINES, DECISION_ENTRY{0, 0, 0, 0});
+    int count = 0;
+
+    while (getline(file, line)) {
+        stringstream ss(line);
+        int down, ydstogo, yardline;
+        int run, pass, kick, punt;
+        char comma;
+
+        // Read integers using ss >> ... >> comma >> ...
+        ss >> down >> comma
+           >> ydstogo >> comma
+           >> yardline >> comma
+           >> run >> comma
+           >> pass >> comma
+           >> kick >> comma
+           >> punt;
+
+        if (!ss || down < 1 || down > 4 || ydstogo < 1 || ydstogo > NUM_YARDLINES || yardline < 1 || yardline > NUM_YARDLINES) {
+            continue;  // malformed, or off the field
+        }
+        DECISION_ENTRY entry = {run, pass, kick, punt};
+        if (ydstogo > MAX_DISTANCE) {  // off the state grid
+            if (fourth_beyond_grid && down == 4) {
+                (*fourth_beyond_grid)[(ydstogo - MAX_DISTANCE - 1) * NUM_YARDLINES + yardline - 1] = entry;
+            }
+            continue;
+        }
+
+        decision_data[state_index(down, ydstogo, yardline)] = entry;
+        count++;
+    }
+
+    file.close();
+    cout << "Successfully loaded decision data for " << count << " entries." << endl;
+}
+
+vector<vector<PuntOutcome>> decodePunts(const vector<vector<int>>& punt_data) {
+    vector<vector<PuntOutcome>> punts(punt_data.size());
+    for (size_t i = 0; i < punt_data.size(); i++) {
+        for (int val : punt_data[i]) punts[i].push_back(decode_punt(val, i+1));
+    }
+    return punts;
+}
+
+vector<PuntProfile> buildPuntProfiles(const vector<vector<int>>& punt_data) {
+    vector<vector<PuntOutcome>> punts = decodePunts(punt_data);
+    vector<PuntProfile> punt_profiles(99);
+    for (int yardline = 1; yardline < 100; yardline++) {
+        PuntProfile& profile = punt_profiles[yardline-1];
+        int num_punts = punts[yardline-1].size();
+        if (num_punts == 0) continue;  // too few punts recorded from here
+
+        profile.empty = false;
+        profile.punts = punts[yardline-1];
+        profile.prior_weight.assign(99, 0.0);
+        double share = 1.0 / num_punts;
+        for (const PuntOutcome& punt : punts[yardline-1]) {
+            switch (punt.kind) {
+                case PUNT_RECEIVED:       profile.prior_weight[punt.yardline-1] -= share; break;  // Other team gets ball
+                case PUNT_TOUCHBACK:      profile.touchback += share; break;
+                case PUNT_RETURN_TD:      profile.td_against += share; break;
+                case PUNT_MUFF_RECOVERED: profile.prior_weight[punt.yardline-1] += share; break;
+                case PUNT_MUFF_TD:        profile.td_for += share; break;
+            }
+        }
+    }
+    return punt_profiles;
+}
+
+// Reads every state's columns back into table.states; a file that does not cover every state is rejected,
+// so a half-written table is never used
+bool loadEPTable(const string& filename, EPTable& table) {
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Error opening file: " << filename << endl;
+        return false;
+    }
+
+    string line;
+    getline(file, line);  // Skip header
+
+    int count = 0;
+    while (getline(file, line)) {
+        // from_chars rather than a stringstream per line: warm starts and the EP server reload whole tables
+        int down, distance, yardline, opt_choice;
+        double run_ep, pass_ep, kick_ep, punt_ep, max_ep;
+        const char* p = line.data();
+        const char* end = p + line.size();
+        bool ok = true;
+        auto next = [&](auto& value) {
+            auto result = from_chars(p, end, value);
+            ok = ok && result.ec == errc();
+            p = (result.ptr < end) ? result.ptr + 1 : end;  // past the comma
+        };
+        next(down);
+        next(distance);
+        next(yardline);
+        next(run_ep);
+        next(pass_ep);
+        next(kick_ep);
+        next(punt_ep);
+        next(max_ep);
+        next(opt_choice);
+
+        if (!ok || down < 1 || down > 4 || distance < 1 || distance > MAX_DISTANCE || yardline < 1 || yardline > NUM_YARDLINES) continue;
+
+        int index = state_index(down, distance, yardline);
+        if (!table.states.computed[index]) count++;
+        table.states.set(index, run_ep, pass_ep, kick_ep, punt_ep, max_ep, opt_choice);
+    }
+
+    int expected = 0;
+    for (int yardline = 1; yardline <= NUM_YARDLINES; yardline++) expected += NUM_DOWNS * min(yardline, MAX_DISTANCE);
+    if (count != expected) {
+        cerr << "Incomplete EP table " << filename << ": " << count << " of " << expected << " states" << endl;
+        return false;
+    }
+
+    table.prior.prior_epas.assign(99, 0.0);
+    table.prior.update(table.states);
+    return true;
+}
+
+// Function to save results to CSV with separate Down and Distance columns
+void saveDataToCSV(string filename, StateTable& table, bool full_precision) {
+    CSVWriter file(full_precision);
+    if (!file.open(filename)) {
+        return;
+    }
+
+    // Write CSV Header
+    file.line("Down,Distance,Yardline,Run_EP,Pass_EP,Kick_EP,Punt_EP,EP,Opt_Choice");
+
+    for (int down = 1; down <= NUM_DOWNS; down++) {
+        for (int distance = 1; distance <= MAX_DISTANCE; distance++) {
+            for (int yardline = 1; yardline <= NUM_YARDLINES; yardline++) {
+                int index = state_index(down, distance, yardline);
+                if (!table.computed[index]) continue;
+
+                file.field(down);
+                file.field(distance);
+                file.field(yardline);
+                write_state_fields(file, table, index);
+                file.end_row();
+            }
+        }
+    }
+
+    if (!file.close()) {
+        cerr << "Error writing file: " << filename << endl;
+        return;
+    }
+    cout << "Combined CSV saved to: " << filename << endl;
+}
+
+vector<InputHash> inputHashes(const CDFStore& cdf_store, const vector<vector<int>>& punt_data) {
+    vector<InputHash> inputs;
+    for (size_t play = 0; play < play_types.size(); play++) {
+        for (size_t bin = 0; bin < yardline_bins.size(); bin++) {
+            inputs.push_back({play_types[play] + "_cdf_yl" + yardline_bins[bin] + ".json", cdf_store.content_hash(play, bin)});
+        }
+    }
+    if (punt_data.empty()) return inputs;
+    uint64_t punt_hash = fnv1a_64(nullptr, 0);
+    for (const vector<int>& punts : punt_data) {
+        uint32_t size = punts.size();
+        punt_hash = fnv1a_64(reinterpret_cast<const unsigned char*>(&size), sizeof(size), punt_hash);
+        punt_hash = fnv1a_64(reinterpret_cast<const unsigned char*>(punts.data()), punts.size() * sizeof(int), punt_hash);
+    }
+    inputs.push_back({"punt_net_yards", punt_hash});
+    return inputs;
+}
+
+bool saveInputManifest(const string& filename, const vector<InputHash>& inputs) {
+    ofstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Error opening file: " << filename << endl;
+        return false;
+    }
+    file << "Input,Hash" << endl;
+    for (const auto& [name, hash] : inputs) {
+        file << name << "," << hex << hash << dec << endl;
+    }
+    return bool(file);
+}
+
+bool loadInputManifest(const string& filename, vector<InputHash>& inputs) {
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Error opening file: " << filename << endl;
+        return false;
+    }
+    inputs.clear();
+    string line;
+    getline(file, line);  // Skip header
+    while (getline(file, line)) {
+        size_t comma = line.find(',');
+        if (comma == string::npos) continue;
+        inputs.push_back({line.substr(0, comma), stoull(line.substr(comma + 1), nullptr, 16)});
+    }
+    return true;
+}
+
+void addModelToCacheKey(ResultCache& cache, const vector<InputHash>& inputs, const vector<double>& field_goals) {
+    cache.add("max_distance", MAX_DISTANCE);
+    cache.add("td_val", TD_VAL);
+    cache.add("fg_val", FG_VAL);
+    cache.add("ko_val", KO_VAL);
+    cache.add("kickoffs", "safety kick from 70, touchback at 80");  // where SKO_VAL and TB_VAL read the prior
+    cache.add("fg_prob", field_goals);
+    for (const auto& [name, hash] : inputs) {
+        cache.add_hash(name, hash);
+    }
+}
+
+// Every state in sweep order: yardline ascending, down descending, distance ascending
+vector<array<int, 3>> sweep_order() {
+    vector<array<int, 3>> order;
+    for (int yardline = 1; yardline < 100; yardline++) {
+        for (int down = 4; down > 0; down--) {
+            for (int yards_to_go = 1; yards_to_go <= MAX_DISTANCE; yards_to_go++) {
+                if (yards_to_go > yardline) continue;            // Can't have first and 10 from 5 yard line
+                order.push_back({down, yards_to_go, yardline});
+            }
+        }
+    }
+    return order;
+}
+
+bool parseSweepOrder(const string& name, SweepOrder& order) {
+    if (name == "gauss-seidel") {
+        order = GAUSS_SEIDEL;
+    } else if (name == "jacobi") {
+        order = JACOBI;
+    } else if (name == "red-black") {
+        order = RED_BLACK;
+    } else {
+        cerr << "Unknown sweep order " << name << " (gauss-seidel, jacobi or red-black)" << endl;
+        return false;
+    }
+    return true;
+}
+
+string sweepOrderName(SweepOrder order) {
+    switch (order) {
+        case JACOBI: return "jacobi";
+        case RED_BLACK: return "red-black";
+        default: return "gauss-seidel";
+    }
+}
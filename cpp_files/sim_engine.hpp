@@ -0,0 +1,908 @@
+#ifndef SIM_ENGINE_HPP
+#define SIM_ENGINE_HPP
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "state_table.hpp"
+#include "cdf_store.hpp"
+#include "thread_pool.hpp"
+#include "progress.hpp"
+#include "csv_writer.hpp"
+#include "sparse_solver.hpp"
+#include "expectation_kernel.hpp"
+#include "result_cache.hpp"
+
+// One EP engine for every simulator. A variant is Engine<Prior, Decision>:
+//   Prior     NaivePrior (possessions end at 0, no punts) or PropagatedPrior (the other team's EPs from a prior)
+//   Decision  MaxPlay (best play in each state) or DecisionMix (plays weighted by how often teams chose them)
+// Both are template parameters, so each binary gets its own inlined kernel
+// The non-template pieces (loaders, tables, CSV output) are in sim_engine.cpp, built into libsim_engine.a
+
+const double TD_VAL = 6.945;
+const double FG_VAL = 3;
+const double KO_VAL = 0;   // Average EP of kickoff for opponent (0 for biased, mimicing nflfastr ep calculations)
+
+// Field Goal Probabilities by yardline position
+extern const std::vector<double> fg_prob;        // simulator, simulator_norm, simulator_mc
+extern const std::vector<double> fg_prob_naive;  // simulator_naive, simulator_naive_norm
+
+// The scoring a prior values results with: the constants above, or one scenario's in a batched run (--scenarios)
+struct Scoring {
+    double td_val;
+    double fg_val;
+    double ko_val;
+    std::vector<double> field_goals;  // make probability by yardline
+
+    double touchdown() const { return td_val - ko_val; }  // Touchdown + Expected Extra Point - EP after kickoff
+};
+
+// Structure to hold a Decision entry
+struct DECISION_ENTRY {
+    int run;
+    int pass;
+    int kick;
+    int punt;
+};
+
+// A yardline's punts reduced to weights on prior_epas plus the share of each fixed outcome, built once from punt_data
+struct PuntProfile {
+    std::vector<double> prior_weight;  // weight on prior_epas[i], averaged over the punts
+    double td_for = 0;                 // recovered muff returned for a touchdown
+    double td_against = 0;             // punt returned for a touchdown
+    double touchback = 0;
+    std::vector<PuntOutcome> punts;    // as recorded; punt_ep sums them in this order, as the simulators always have
+    bool empty = true;
+};
+
+void generateYardlineMapping(std::vector<int>& yardline_mapping);
+int reportMissingCDFs(const CDFStore& cdf_store, const std::vector<int>& yardline_mapping);  // number missing
+void loadPriorData(const std::string& filename, std::vector<double>& data);     // first-and-10 (or goal-to-go) EPs
+void loadPriorDataFromCSV(const std::string& filename, StateTable& table);     // every state's EP, into table.prior
+void loadPuntNetYards(std::vector<std::vector<int>>& puntYards, const std::string& filename);
+std::vector<std::vector<PuntOutcome>> decodePunts(const std::vector<std::vector<int>>& punt_data);  // by yardline
+// Rows past MAX_DISTANCE are dropped, or with fourth_beyond_grid the 4th down ones are kept there, indexed like
+// NaivePrior::beyond_grid_eps
+void loadDecisionData(const std::string& filename, std::vector<DECISION_ENTRY>& decision_data,
+                      std::vector<DECISION_ENTRY>* fourth_beyond_grid = nullptr);
+std::vector<PuntProfile> buildPuntProfiles(const std::vector<std::vector<int>>& punt_data);
+void saveDataToCSV(std::string filename, StateTable& table, bool full_precision);
+
+// Content hash of each input a table is built from: one per CDF file (play type and yardline bin), and the punt data
+// if there is any. Saved next to a table so a later --incremental run can tell which inputs changed
+typedef std::pair<std::string, uint64_t> InputHash;
+std::vector<InputHash> inputHashes(const CDFStore& cdf_store, const std::vector<std::vector<int>>& punt_data);
+bool saveInputManifest(const std::string& filename, const std::vector<InputHash>& inputs);
+bool loadInputManifest(const std::string& filename, std::vector<InputHash>& inputs);
+
+// Adds the model to a result cache key: the scoring constants, kickoff conventions, field goal table, grid size
+// and the input hashes
+void addModelToCacheKey(ResultCache& cache, const std::vector<InputHash>& inputs, const std::vector<double>& field_goals);
+
+// First-and-10 (or goal-to-go) state at a yardline, the rows a prior is taken from
+inline int prior_state(int yardline) {
+    return state_index(1, (yardline < 10) ? yardline : 10, yardline);
+}
+
+// Every state in sweep order: yardline ascending, down descending, distance ascending
+std::vector<std::array<int, 3>> sweep_order();
+
+// How a sweep orders its state updates (--order in simulator and simulator_naive)
+enum SweepOrder {
+    GAUSS_SEIDEL,   // in place, in sweep_order(): forward progress, so a gain reads the EP already updated this sweep
+    JACOBI,         // every state reads the previous sweep's EPs, the same result for any thread count
+    RED_BLACK       // the states with even down + distance + yardline, then the odd ones, Jacobi within each half
+};
+bool parseSweepOrder(const std::string& name, SweepOrder& order);   // gauss-seidel, jacobi or red-black
+std::string sweepOrderName(SweepOrder order);                       // the name parseSweepOrder reads
+
+// Where a sampled play leaves the ball, reported to a sink that turns it into an EP (or an expression for one):
+//   points(c)               possession over for c points
+//   touchdown()             the offense scores a touchdown (Scoring::touchdown())
+//   touchdown_against()     the other team returns it for a touchdown (-Scoring::td_val)
+//   opponent(yl)            the other team has first down at yl (their EP, negated)
+//   opponent_after(c, yl)   c points, then the other team has first down at yl
+//   state(index)            the drive goes on from another state
+template <class Prior, class Sink>
+inline double play_result(const Prior& prior, PlayOutcome outcome, int down, int yards_to_go, int yardline, Sink& sink) {
+    if (outcome.turnover()) {
+        return prior.turnover(outcome, yardline, sink);
+    }
+
+    int val = outcome.yards;
+    int new_yardline = yardline - val;
+    if (new_yardline <= 0) {
+        return sink.touchdown();
+    }
+
+    if (new_yardline >= 100) {
+        return prior.safety(sink);
+    }
+
+    int new_down = down + 1;
+    int new_yards_to_go = yards_to_go - val;
+
+    if (new_yards_to_go <= 0) {
+        new_down = 1;
+        new_yards_to_go = (10 <= new_yardline) ? 10 : new_yardline;
+    } else if (new_yards_to_go > 0 && new_down > 4) {
+        return prior.downs(new_yardline, sink);
+    }
+
+    if (new_yards_to_go > new_yardline) {
+        return sink.points(0);
+    }
+
+    if (new_yards_to_go > MAX_DISTANCE) {
+        if constexpr (!Prior::cap_distance) {
+            return prior.beyond_grid(new_down, new_yards_to_go, new_yardline, sink);  // off the distance grid
+        }
+        new_yards_to_go = MAX_DISTANCE;
+    }
+
+    return sink.state(state_index(new_down, new_yards_to_go, new_yardline));
+}
+
+// No prior knowledge: turnovers and turnovers on downs are worth 0, a safety -2, no punts
+struct NaivePrior {
+    static const bool has_punts = false;
+    static const bool cap_distance = false;
+    static const int kick_range = 99;
+
+    Scoring scoring{TD_VAL, FG_VAL, KO_VAL, fg_prob_naive};
+
+    // 4th down EPs past MAX_DISTANCE, by (distance - MAX_DISTANCE - 1) * NUM_YARDLINES + yardline - 1. There are no
+    // CDFs that far out, so only the field goal counts, weighted by how often teams kicked there (simulator_naive_norm,
+    // from weigh_beyond_grid). Left empty, every state past the grid is worth 0
+    std::vector<double> beyond_grid_eps;
+
+    void begin_epoch() {}
+
+    void weigh_beyond_grid(const std::vector<DECISION_ENTRY>& fourth_downs) {
+        beyond_grid_eps.assign(fourth_downs.size(), 0.0);
+        for (size_t i = 0; i < fourth_downs.size(); i++) {
+            const DECISION_ENTRY& dec = fourth_downs[i];
+            double sum = dec.run + dec.pass + dec.kick + dec.punt;
+            if (sum > 0) beyond_grid_eps[i] = dec.kick/sum * kick(i % NUM_YARDLINES + 1);
+        }
+    }
+
+    template <class Sink> double beyond_grid(int down, int distance, int yardline, Sink& sink) const {
+        if (down != 4 || beyond_grid_eps.empty()) return sink.points(0);
+        return sink.points(beyond_grid_eps[(distance - MAX_DISTANCE - 1) * NUM_YARDLINES + yardline - 1]);
+    }
+
+    template <class Sink> double turnover(PlayOutcome, int, Sink& sink) const { return sink.points(0); }
+    template <class Sink> double safety(Sink& sink) const { return sink.points(-2); }  // Safety placeholder
+    template <class Sink> double downs(int, Sink& sink) const { return sink.points(0); }
+
+    double ep(int) const { return 0; }  // the other team's possessions are never valued
+    double kick(int yardline) const { return scoring.field_goals[yardline-1]*scoring.fg_val; }
+    double punt(int) const { return 0; }
+    bool punt_available(int) const { return false; }
+
+    LinearExpr kick_terms(int yardline) const {
+        LinearExpr expr;
+        expr.add(kick(yardline));
+        return expr;
+    }
+    LinearExpr punt_terms(int) const { return LinearExpr(); }
+};
+
+// The other team's EPs come from prior_epas (first-and-10 or goal-to-go EP by yardline)
+struct PropagatedPrior {
+    static const bool has_punts = true;
+    static const bool cap_distance = true;  // longer distances are played as MAX_DISTANCE
+    static const int kick_range = 60;       // no field goals tried from further out
+
+    Scoring scoring{TD_VAL, FG_VAL, KO_VAL, fg_prob};
+    std::vector<double> prior_epas;
+    std::vector<PuntProfile> punt_profiles;
+    std::vector<double> kick_table = std::vector<double>(99);  // kick EP per yardline for the current prior_epas
+    std::vector<double> punt_table = std::vector<double>(99);  // punt EP per yardline for the current prior_epas
+    double SKO_VAL = 0; // safety kickoff
+    double TB_VAL = 0;
+
+    // Kickoff values and the punt and field goal tables only depend on prior_epas, so compute them once per epoch
+    void begin_epoch() {
+        SKO_VAL = prior_epas[70-1];
+        TB_VAL = prior_epas[80-1];
+        for (int yardline = 1; yardline < 100; yardline++) {
+            double make = scoring.field_goals[yardline-1];
+            double miss_penalty = (yardline+7 < 100) ? -(1-make)*prior_epas[100-(yardline+7)-1] : -2 - SKO_VAL;
+            kick_table[yardline-1] = make*(scoring.fg_val - scoring.ko_val) + miss_penalty;
+            punt_table[yardline-1] = punt_ep(yardline);
+        }
+    }
+
+    // Pull the first-and-10 (or goal-to-go) EP for each yardline out of table.max, the same rows loadPriorData keeps
+    // Returns the largest absolute change from the current prior_epas
+    double update(const StateTable& table) {
+        double max_change = 0.0;
+        for (int yardline = 1; yardline < 100; yardline++) {
+            double ep = table.max[prior_state(yardline)];
+            max_change = std::max(max_change, std::abs(ep - prior_epas[yardline-1]));
+            prior_epas[yardline-1] = ep;
+        }
+        return max_change;
+    }
+
+    double ep(int yardline) const { return prior_epas[yardline-1]; }
+
+    template <class Sink> double turnover(PlayOutcome outcome, int yardline, Sink& sink) const {
+        int new_yl = 100-(yardline-outcome.yards);  // interception or fumble
+        if(new_yl >= 100){
+            return sink.opponent(80);  // Interception touchback
+        } else if(new_yl <= 0){
+            return sink.touchdown_against();
+        }
+        return sink.opponent(new_yl);
+    }
+
+    // Safety - EP after kickoff  (new safety kick rules make it essentially the same as a regular kickoff)
+    template <class Sink> double safety(Sink& sink) const { return sink.opponent_after(-2, 70); }
+
+    template <class Sink> double downs(int new_yardline, Sink& sink) const { return sink.opponent(100-new_yardline); }
+
+    double kick(int yardline) const { return kick_table[yardline-1]; }
+    double punt(int yardline) const { return punt_table[yardline-1]; }
+    bool punt_available(int yardline) const { return !punt_profiles[yardline-1].empty; }
+
+    double punt_ep(int yardline) const {
+        const PuntProfile& profile = punt_profiles[yardline-1];
+        if(profile.empty){
+            return -TB_VAL;
+        }
+        double epa_val = 0.0;
+        for (const PuntOutcome& punt : profile.punts) {
+            switch (punt.kind) {
+                case PUNT_RECEIVED:       epa_val -= prior_epas[punt.yardline-1]; break;  // Other team gets ball
+                case PUNT_TOUCHBACK:      epa_val -= TB_VAL; break;
+                case PUNT_RETURN_TD:      epa_val -= scoring.td_val; break;
+                case PUNT_MUFF_RECOVERED: epa_val += prior_epas[punt.yardline-1]; break;
+                case PUNT_MUFF_TD:        epa_val += scoring.touchdown(); break;
+            }
+        }
+        return epa_val / profile.punts.size();
+    }
+
+    LinearExpr kick_terms(int yardline) const {
+        LinearExpr expr;
+        double make = scoring.field_goals[yardline-1];
+        expr.add(make*(scoring.fg_val - scoring.ko_val));
+        if (yardline+7 < 100) {
+            expr.add(prior_state(100-(yardline+7)), -(1-make));
+        } else {
+            expr.add(-2.0);
+            expr.add(prior_state(70), -1.0);
+        }
+        return expr;
+    }
+
+    LinearExpr punt_terms(int yardline) const {
+        const PuntProfile& profile = punt_profiles[yardline-1];
+        LinearExpr expr;
+        if(profile.empty){
+            expr.add(prior_state(80), -1.0);
+            return expr;
+        }
+        expr.add(profile.td_for*scoring.touchdown() - profile.td_against*scoring.td_val);
+        expr.add(prior_state(80), -profile.touchback);
+        for (int i = 0; i < 99; i++) {
+            if (profile.prior_weight[i] != 0) expr.add(prior_state(i+1), profile.prior_weight[i]);
+        }
+        expr.compress();
+        return expr;
+    }
+};
+
+// The best of run, pass, field goal (4th down in range) and punt
+struct MaxPlay {
+    template <class Prior>
+    void finish(StateTable& states, const Prior& prior, int index, int down, int yardline, double epa_rush_val,
+                double epa_pass_val) const {
+        double epas[4];
+        int max_index = best(prior, down, yardline, epa_rush_val, epa_pass_val, epas);
+        states.set(index, epas[0], epas[1], epas[2], epas[3], epas[max_index], max_index);
+    }
+
+    // Fills epas with the run, pass, field goal and punt EPs and returns the best one's index
+    template <class Prior>
+    static int best(const Prior& prior, int down, int yardline, double epa_rush_val, double epa_pass_val, double epas[4]) {
+        double epa_kick_val = (down == 4 && yardline <= Prior::kick_range) ? prior.kick(yardline) : -1000;  // only viable if it is 4th down
+        double epa_punt_val = 0;
+        if (Prior::has_punts) {
+            epa_punt_val = prior.punt_available(yardline) ? prior.punt(yardline) : -1000;  // too close, never punting
+        }
+
+        epas[0] = epa_rush_val;
+        epas[1] = epa_pass_val;
+        epas[2] = epa_kick_val;
+        epas[3] = epa_punt_val;
+        int choices = Prior::has_punts ? 4 : 3;
+        return std::max_element(epas, epas + choices) - epas;
+    }
+
+    // Play EPs as expressions, for the linear solve
+    template <class Prior>
+    void kick_punt_terms(const Prior& prior, int down, int yardline, LinearExpr& kick, LinearExpr& punt) const {
+        if (down == 4 && yardline <= Prior::kick_range) {
+            kick = prior.kick_terms(yardline);
+        } else {
+            kick.add(-1000.0);
+        }
+        if (Prior::has_punts && !prior.punt_available(yardline)) {
+            punt.add(-1000.0);
+        } else {
+            punt = prior.punt_terms(yardline);
+        }
+    }
+};
+
+// Plays weighted by how often teams chose them in each state (kicks and punts on 4th down only)
+struct DecisionMix {
+    std::vector<DECISION_ENTRY> decision_data;
+
+    // Weights of run, pass, kick and punt in a state
+    std::array<double, 4> weights(int index, int down) const {
+        DECISION_ENTRY dec = decision_data[index];
+        if (down != 4) {
+            dec.kick = 0;
+            dec.punt = 0;
+        }
+        double sum = dec.run + dec.pass + dec.kick + dec.punt;
+        if (sum == 0){
+            sum = 1;
+        }
+        return {dec.run/sum, dec.pass/sum, dec.kick/sum, dec.punt/sum};
+    }
+
+    template <class Prior>
+    void finish(StateTable& states, const Prior& prior, int index, int down, int yardline, double epa_rush_val,
+                double epa_pass_val) const {
+        double epa_kick_val = prior.kick(yardline);  // only weighted on 4th down
+        double epa_punt_val = prior.punt(yardline);
+        std::array<double, 4> w = weights(index, down);
+
+        double max_epa = w[0] * epa_rush_val + w[1] * epa_pass_val + w[2] * epa_kick_val;
+        if (Prior::has_punts) max_epa += w[3] * epa_punt_val;
+
+        double epas[] = {epa_rush_val, epa_pass_val, epa_kick_val, epa_punt_val};
+        int max_index = std::max_element(epas, epas + (Prior::has_punts ? 4 : 3)) - epas;
+        states.set(index, epa_rush_val, epa_pass_val, epa_kick_val, epa_punt_val, max_epa, max_index);
+    }
+
+    template <class Prior>
+    void kick_punt_terms(const Prior& prior, int, int yardline, LinearExpr& kick, LinearExpr& punt) const {
+        kick = prior.kick_terms(yardline);
+        punt = prior.punt_terms(yardline);
+    }
+};
+
+template <class Prior, class Decision>
+class Engine {
+public:
+    StateTable states;
+    Prior prior;
+    Decision decision;
+
+    Engine(CDFStore& cdf_store, std::vector<int>& yardline_mapping)
+        : cdf_store(cdf_store), yardline_mapping(yardline_mapping), order(sweep_order()) {
+        for (const auto& state : order) {
+            colors[(state[0] + state[1] + state[2]) % 2].push_back(state);
+        }
+    }
+
+    // ---- Sweeps ----
+
+    // Evaluate one state from its compiled CDFs and store the result
+    // Successor states are read from lookup: kept equal to states.max for an in-place sweep (in_place writes each
+    // new EP back), the previous sweep's values for a Jacobi sweep
+    void evaluate_state(int down, int yards_to_go, int yardline, bool in_place) {
+        int index = state_index(down, yards_to_go, yardline);
+        double epa_vals[2];  // rush, pass
+
+        for (int play = 0; play < 2; play++) {
+            uint32_t begin = outcomes.start[2*index + play];
+            uint32_t n = outcomes.start[2*index + play + 1] - begin;
+            epa_vals[play] = expectation(&outcomes.mass[begin], &outcomes.constant[begin], &outcomes.gather[begin], n,
+                                         lookup.data());
+        }
+
+        if (epa_vals[0] > 1e10 || epa_vals[1] > 1e10 || epa_vals[0]<=-1e6) {
+            std::cerr << down << "-" << yards_to_go << " " << yardline << ": Large EPAs encounted (Re-run program): "
+                      << epa_vals[0] << ", " << epa_vals[1] << std::endl;
+            exit(1);
+        }
+
+        decision.finish(states, prior, index, down, yardline, epa_vals[0], epa_vals[1]);
+        if (in_place) lookup[index] = states.max[index];
+    }
+
+    // One sweep over every state, returns the largest change in any state's EP
+    // Gauss-Seidel: later states in the sweep see this sweep's values for earlier ones (single thread only)
+    // Jacobi: every state reads the previous sweep's values, so states can be split across the pool in any way
+    // and give bit-identical results
+    // Red-black: a Jacobi half-sweep over each parity in turn, the second reading the first's new values; also
+    // bit-identical for any thread count
+    // cold: states read 0 for any state not yet updated this sweep instead of its previous EP, as each process of
+    // the old one-epoch-per-process scripts did
+    double sweep(ThreadPool& pool, SweepOrder strategy, bool cold = false) {
+        if (outcomes.empty()) compile_outcomes();
+        const std::vector<double> previous_max = states.max;
+
+        // The previous sweep's EPs, and the other team's EPs from the prior (fixed for the whole sweep)
+        if (cold) {
+            std::fill(lookup.begin(), lookup.begin() + NUM_STATES, 0.0);
+        } else {
+            std::copy(previous_max.begin(), previous_max.end(), lookup.begin());
+        }
+        for (int yardline = 1; yardline < 100; yardline++) {
+            lookup[LOOKUP_OPPONENT + yardline - 1] = -prior.ep(yardline);
+        }
+        lookup[LOOKUP_ZERO] = 0.0;
+
+        if (strategy == GAUSS_SEIDEL) {
+            for (const auto& [down, yards_to_go, yardline] : order) {
+                evaluate_state(down, yards_to_go, yardline, true);
+            }
+        } else if (strategy == JACOBI) {
+            jacobi_sweep(pool, order);
+        } else {
+            for (const auto& half : colors) {
+                jacobi_sweep(pool, half);
+                for (const auto& [down, yards_to_go, yardline] : half) {
+                    int index = state_index(down, yards_to_go, yardline);
+                    lookup[index] = states.max[index];
+                }
+            }
+        }
+
+        double change = 0.0;
+        for (int i = 0; i < NUM_STATES; i++) {
+            change = std::max(change, std::abs(states.max[i] - previous_max[i]));
+        }
+        return change;
+    }
+
+    // ---- Depth-first evaluation ----
+
+    // Evaluates a state and every state it reaches that has not been computed this sweep, depth first on an
+    // explicit stack so deep grids cannot overflow the call stack. Each state is entered once per sweep; a state
+    // reached again while it is still on the stack (a cycle) contributes its prior EP (states.prior)
+    double get_epa(int down, int yards_to_go, int yardline) {
+        int index = state_index(down, yards_to_go, yardline);
+        if(states.visited[index]){
+            return states.computed[index] ? states.max[index] : states.prior[index];
+        }
+
+        if (outcomes.empty()) compile_outcomes();
+        epa_stack.clear();
+        epa_stack.reserve(NUM_STATES);
+        push_state(index);
+
+        while (!epa_stack.empty()) {
+            EPAFrame& frame = epa_stack.back();
+            bool descended = false;
+
+            while (!descended && frame.play < 2) {
+                uint32_t end = outcomes.start[2*frame.index + frame.play + 1];
+                while (frame.outcome < end) {
+                    int32_t slot = outcomes.gather[frame.outcome];
+                    double epa;
+                    if (slot < NUM_STATES) {
+                        if (!states.visited[slot]) {
+                            // Evaluate the next state first, then come back to this outcome
+                            push_state(slot);
+                            descended = true;
+                            break;
+                        }
+                        epa = states.computed[slot] ? states.max[slot] : states.prior[slot];
+                    } else {
+                        // A fixed result, or the other team's EP from the current prior
+                        epa = outcomes.constant[frame.outcome] + ((slot == LOOKUP_ZERO) ? 0.0 : -prior.ep(slot - LOOKUP_OPPONENT + 1));
+                    }
+                    frame.epa_vals[frame.play] += outcomes.mass[frame.outcome] * epa;
+                    frame.outcome++;
+                }
+                if (!descended) {
+                    frame.play++;
+                    frame.outcome = outcomes.start[2*frame.index + frame.play];
+                }
+            }
+            if (descended) continue;  // frame may have moved when the stack grew
+
+            decision.finish(states, prior, frame.index, frame.down, frame.yardline, frame.epa_vals[0], frame.epa_vals[1]);
+            epa_stack.pop_back();
+        }
+
+        return states.max[index];
+    }
+
+    // get_epa for every state of one down
+    void evaluate_down(int down) {
+        for (int yardline = 1; yardline < 100; yardline++) {
+            for (int yards_to_go = 1; yards_to_go <= MAX_DISTANCE; yards_to_go++) {
+                if (yards_to_go > yardline) continue;            // Can't have first and 10 from 5 yard line
+                get_epa(down, yards_to_go, yardline);
+            }
+        }
+    }
+
+    // ---- Linear solve ----
+
+    // Every EP as an expression in the other states' EPs, with the prior taken from the same solution
+    // (prior_epas[yardline-1] is prior_state(yardline)), so the solution is the fixed point the epochs converge to.
+    // DecisionMix solves that system once; MaxPlay runs policy iteration: solve for the current plays, switch each
+    // state to a strictly better play under the solution, and repeat until no state switches
+    // Fills states (and prior_epas) from the solution, returns false if a solve failed or the plays never settled
+    bool solve(Progress& progress) {
+        if (outcomes.empty()) compile_outcomes();
+        std::vector<std::array<LinearExpr, 4>> play_terms(NUM_STATES);  // rush, pass, kick, punt
+        std::vector<char> valid(NUM_STATES, 0);
+
+        for (const auto& [down, yards_to_go, yardline] : order) {
+            int index = state_index(down, yards_to_go, yardline);
+            valid[index] = 1;
+            std::array<LinearExpr, 4>& terms = play_terms[index];
+
+            // Rush and pass rows of the compiled outcomes, with the other team's EPs as their first-and-10 states
+            for (int play = 0; play < 2; play++) {
+                for (uint32_t i = outcomes.start[2*index + play]; i < outcomes.start[2*index + play + 1]; i++) {
+                    int32_t slot = outcomes.gather[i];
+                    if (slot < NUM_STATES) {
+                        terms[play].add(slot, outcomes.mass[i]);
+                        continue;
+                    }
+                    if (slot == LOOKUP_ZERO || outcomes.constant[i] != 0) terms[play].add(outcomes.mass[i] * outcomes.constant[i]);
+                    if (slot != LOOKUP_ZERO) terms[play].add(prior_state(slot - LOOKUP_OPPONENT + 1), -outcomes.mass[i]);
+                }
+                terms[play].compress();
+            }
+            decision.kick_punt_terms(prior, down, yardline, terms[2], terms[3]);
+        }
+
+        // Start from the prior file's EPs (states.prior, where loaded) and the prior's first-down EPs
+        std::vector<double> x = states.prior;
+        prior_to_states(x);
+
+        std::vector<LinearExpr> rows(NUM_STATES);
+        std::vector<int> policy(NUM_STATES, 0);
+        SparseMatrix A;
+        std::vector<double> b;
+        const bool max_play = std::is_same<Decision, MaxPlay>::value;
+
+        for (int iteration = 1; iteration <= MAX_POLICY_ITERATIONS; iteration++) {
+            int changes = 0;
+            for (int index = 0; index < NUM_STATES; index++) {
+                if (!valid[index]) continue;
+                if (!max_play) {
+                    if (iteration > 1) continue;
+                    int down = index / (NUM_YARDLINES * MAX_DISTANCE) + 1;
+                    std::array<double, 4> w = mix_weights(index, down);
+                    for (int play = 0; play < 4; play++) rows[index].add(play_terms[index][play], w[play]);
+                    rows[index].compress();
+                    changes++;
+                    continue;
+                }
+
+                // Policy improvement, a state only switches to a strictly better play
+                int best = policy[index];
+                double best_epa = play_terms[index][best].evaluate(x);
+                for (int play = 0; play < (Prior::has_punts ? 4 : 3); play++) {
+                    double epa = play_terms[index][play].evaluate(x);
+                    if (epa > best_epa + SOLVE_TOLERANCE * (1 + std::abs(best_epa))) {
+                        best = play;
+                        best_epa = epa;
+                    }
+                }
+                if (best != policy[index] || iteration == 1) {
+                    policy[index] = best;
+                    rows[index] = play_terms[index][best];
+                    changes++;
+                }
+            }
+
+            if (changes == 0) {
+                if (max_play) {
+                    std::cout << "Policy iteration converged after " << iteration - 1 << " solves" << std::endl;
+                    progress.report("Policy iteration", iteration - 1, iteration - 1);
+                }
+                store_solution(x, play_terms, valid, policy);
+                return true;
+            }
+
+            build_fixed_point_system(rows, A, b);
+            double residual;
+            int solver_iterations = solve_bicgstab(A, b, x, SOLVE_TOLERANCE, 1000, &residual);
+            if (solver_iterations < 0) {
+                std::cout << "Linear solve did not reach tolerance " << SOLVE_TOLERANCE << " (relative residual " << residual << ")" << std::endl;
+                return false;
+            }
+            if (max_play) {
+                std::cout << "Policy iteration " << iteration << ": " << changes << " plays changed, " << solver_iterations
+                          << " solver iterations, relative residual " << residual << std::endl;
+                progress.report("Policy iteration", iteration, MAX_POLICY_ITERATIONS);
+            } else {
+                std::cout << "Linear solve: " << A.vals.size() << " nonzeros, " << solver_iterations
+                          << " iterations, relative residual " << residual << std::endl;
+            }
+        }
+
+        std::cout << "Plays did not settle within " << MAX_POLICY_ITERATIONS << " policy iterations" << std::endl;
+        return false;
+    }
+
+    // ---- Incremental re-solve ----
+
+    // Re-solves a converged table (already in states and prior) after some of its inputs changed. Only the dirty
+    // states are re-evaluated, in place and in sweep order. A state whose EP moves by more than the tolerance dirties
+    // the states that read it: through a play outcome directly, or through the prior (first-and-10 EPs) for the
+    // turnovers, kicks and punts that end in the other team's possession. The dependency graph comes from the
+    // compiled outcomes, so it always matches the data being solved. Returns false if it did not settle
+    bool resolve_incremental(std::vector<char>& dirty, double tolerance, int max_passes, Progress& progress) {
+        if (outcomes.empty()) compile_outcomes();
+        build_dependents();
+        prior.begin_epoch();
+        std::copy(states.max.begin(), states.max.end(), lookup.begin());
+        for (int yardline = 1; yardline < 100; yardline++) {
+            lookup[LOOKUP_OPPONENT + yardline - 1] = -prior.ep(yardline);
+        }
+        lookup[LOOKUP_ZERO] = 0.0;
+
+        long evaluations = 0;
+        for (int pass = 1; pass <= max_passes; pass++) {
+            int evaluated = 0;
+            for (const auto& [down, yards_to_go, yardline] : order) {
+                int index = state_index(down, yards_to_go, yardline);
+                if (!dirty[index]) continue;
+                dirty[index] = 0;
+                double before = states.max[index];
+                evaluate_state(down, yards_to_go, yardline, true);
+                evaluated++;
+                if (std::abs(states.max[index] - before) > tolerance) mark_dependents(index, dirty);
+            }
+            evaluations += evaluated;
+
+            // The prior moves with the first-and-10 rows, like at the end of an epoch
+            int prior_moved = 0;
+            if constexpr (std::is_same<Prior, PropagatedPrior>::value) {
+                std::vector<double> old_prior = prior.prior_epas;
+                std::vector<double> old_kick = prior.kick_table;
+                std::vector<double> old_punt = prior.punt_table;
+                prior.update(states);
+                prior.begin_epoch();
+                for (int yardline = 1; yardline < 100; yardline++) {
+                    lookup[LOOKUP_OPPONENT + yardline - 1] = -prior.ep(yardline);
+                    if (std::abs(prior.prior_epas[yardline-1] - old_prior[yardline-1]) > tolerance) {
+                        mark_dependents(LOOKUP_OPPONENT + yardline - 1, dirty);
+                        prior_moved++;
+                    }
+                    if (std::abs(prior.kick_table[yardline-1] - old_kick[yardline-1]) > tolerance ||
+                        std::abs(prior.punt_table[yardline-1] - old_punt[yardline-1]) > tolerance) {
+                        for (int down = 1; down <= 4; down++) {
+                            for (int yards_to_go = 1; yards_to_go <= std::min(yardline, MAX_DISTANCE); yards_to_go++) {
+                                dirty[state_index(down, yards_to_go, yardline)] = 1;
+                            }
+                        }
+                    }
+                }
+            }
+
+            int pending = 0;
+            for (const auto& [down, yards_to_go, yardline] : order) {
+                pending += dirty[state_index(down, yards_to_go, yardline)];
+            }
+            std::cout << "Pass " << pass << ": " << evaluated << " states re-evaluated, " << prior_moved
+                      << " prior EPs moved, " << pending << " states left" << std::endl;
+            progress.report("Pass", pass, (pending == 0) ? pass : max_passes);
+            if (pending == 0) {
+                std::cout << "Re-solved with " << evaluations << " state evaluations ("
+                          << (double)evaluations / order.size() << " full sweeps)" << std::endl;
+                return true;
+            }
+        }
+        std::cout << "Did not settle to " << tolerance << " within " << max_passes << " passes" << std::endl;
+        return false;
+    }
+
+    // States whose CDFs are in one of the changed (play type, yardline bin) files, or every state for bin -1; both
+    // plays are re-evaluated, so the play type does not narrow it down
+    void mark_bin(int bin, std::vector<char>& dirty) const {
+        for (const auto& [down, yards_to_go, yardline] : order) {
+            if (bin < 0 || yardline_mapping[yardline] == bin) dirty[state_index(down, yards_to_go, yardline)] = 1;
+        }
+    }
+
+private:
+    static constexpr double SOLVE_TOLERANCE = 1e-12;  // relative residual for each linear solve
+    static const int MAX_POLICY_ITERATIONS = 50;
+
+    CDFStore& cdf_store;
+    std::vector<int>& yardline_mapping;
+    std::vector<std::array<int, 3>> order;
+    std::vector<std::array<int, 3>> colors[2];          // order split by parity, for red-black sweeps
+
+    OutcomeTable outcomes;                              // compiled on first use, read by every evaluator
+    std::vector<double> lookup = std::vector<double>(LOOKUP_SIZE);
+    std::vector<uint32_t> dependent_start;              // states reading lookup slot s are
+    std::vector<int32_t> dependents;                    //   dependents[dependent_start[s] .. dependent_start[s+1])
+
+    // Inverts the compiled outcomes: for each lookup slot (a state, or the other team's EP at a yardline), the
+    // states with an outcome that reads it
+    void build_dependents() {
+        std::vector<std::vector<int32_t>> readers(LOOKUP_SIZE);
+        for (int index = 0; index < NUM_STATES; index++) {
+            for (uint32_t i = outcomes.start[2*index]; i < outcomes.start[2*index + 2]; i++) {
+                std::vector<int32_t>& list = readers[outcomes.gather[i]];
+                if (list.empty() || list.back() != index) list.push_back(index);
+            }
+        }
+        dependent_start.assign(LOOKUP_SIZE + 1, 0);
+        dependents.clear();
+        for (int slot = 0; slot < LOOKUP_SIZE; slot++) {
+            dependent_start[slot] = dependents.size();
+            dependents.insert(dependents.end(), readers[slot].begin(), readers[slot].end());
+        }
+        dependent_start[LOOKUP_SIZE] = dependents.size();
+    }
+
+    void mark_dependents(int slot, std::vector<char>& dirty) const {
+        for (uint32_t i = dependent_start[slot]; i < dependent_start[slot + 1]; i++) dirty[dependents[i]] = 1;
+    }
+
+    // Evaluates the states from lookup without writing to it, so the states can be split across threads
+    void jacobi_sweep(ThreadPool& pool, const std::vector<std::array<int, 3>>& states_to_sweep) {
+        pool.parallel_for(states_to_sweep.size(), [&](int begin, int end) {
+            for (int i = begin; i < end; i++) {
+                evaluate_state(states_to_sweep[i][0], states_to_sweep[i][1], states_to_sweep[i][2], false);
+            }
+        });
+    }
+
+    // Each result as constant + lookup[gather], see expectation_kernel.hpp
+    struct CompileSink {
+        const Scoring& scoring;
+        double constant;
+        int32_t gather;
+        double points(double value) { constant = value; gather = LOOKUP_ZERO; return 0; }
+        double touchdown() { return points(scoring.touchdown()); }
+        double touchdown_against() { return points(-scoring.td_val); }
+        double opponent(int yardline) { constant = 0.0; gather = LOOKUP_OPPONENT + yardline - 1; return 0; }
+        double opponent_after(double value, int yardline) {
+            constant = value;
+            gather = LOOKUP_OPPONENT + yardline - 1;
+            return 0;
+        }
+        double state(int index) { constant = 0.0; gather = index; return 0; }
+    };
+
+    // Decodes every outcome of every state once; nothing here depends on the EPs, so the sweeps, get_epa, solve and
+    // resolve_incremental all share the one table instead of re-deriving each outcome's successor
+    void compile_outcomes() {
+        outcomes.start.assign(2 * NUM_STATES + 1, 0);
+        CompileSink sink{prior.scoring, 0.0, 0};
+        for (int index = 0; index < NUM_STATES; index++) {
+            int yardline = index % NUM_YARDLINES + 1;
+            int yards_to_go = (index / NUM_YARDLINES) % MAX_DISTANCE + 1;
+            int down = index / (NUM_YARDLINES * MAX_DISTANCE) + 1;
+            for (int play = 0; play < 2; play++) {
+                outcomes.start[2*index + play] = outcomes.mass.size();
+                if (yards_to_go > yardline) continue;  // not a state
+                CDFView cdf = cdf_store.find(play, yardline_mapping[yardline], down, yards_to_go);
+                double prev = 0.0;
+                for (uint32_t i = 0; i < cdf.size; i++) {
+                    play_result(prior, cdf.outcomes[i], down, yards_to_go, yardline, sink);
+                    outcomes.mass.push_back(cdf.cdf[i]-prev);
+                    outcomes.constant.push_back(sink.constant);
+                    outcomes.gather.push_back(sink.gather);
+                    prev = cdf.cdf[i];
+                }
+            }
+        }
+        outcomes.start[2 * NUM_STATES] = outcomes.mass.size();
+    }
+
+    // A state whose rush and pass expectations are partly summed, waiting on the state at the top of the stack
+    struct EPAFrame {
+        int index;
+        int down;
+        int yardline;
+        int play;            // which play's outcomes are being summed
+        uint32_t outcome;    // next compiled outcome of that play
+        double epa_vals[2];  // rush, pass sums so far
+    };
+
+    std::vector<EPAFrame> epa_stack;  // reused across calls, holds at most one frame per state
+
+    void push_state(int index) {
+        states.visited[index] = 1;
+        EPAFrame frame;
+        frame.index = index;
+        frame.down = index / (NUM_YARDLINES * MAX_DISTANCE) + 1;
+        frame.yardline = index % NUM_YARDLINES + 1;
+        frame.play = 0;
+        frame.outcome = outcomes.start[2*index];
+        frame.epa_vals[0] = 0.0;
+        frame.epa_vals[1] = 0.0;
+        epa_stack.push_back(frame);
+    }
+
+    std::array<double, 4> mix_weights(int index, int down) const {
+        if constexpr (std::is_same<Decision, DecisionMix>::value) {
+            return decision.weights(index, down);
+        } else {
+            return {0, 0, 0, 0};
+        }
+    }
+
+    void prior_to_states(std::vector<double>& x) const {
+        if constexpr (std::is_same<Prior, PropagatedPrior>::value) {
+            for (int yardline = 1; yardline < 100; yardline++) {
+                x[prior_state(yardline)] = prior.prior_epas[yardline-1];
+            }
+        }
+    }
+
+    void store_solution(const std::vector<double>& x, const std::vector<std::array<LinearExpr, 4>>& play_terms,
+                        const std::vector<char>& valid, const std::vector<int>& policy) {
+        if constexpr (std::is_same<Prior, PropagatedPrior>::value) {
+            for (int yardline = 1; yardline < 100; yardline++) {
+                prior.prior_epas[yardline-1] = x[prior_state(yardline)];
+            }
+        }
+        prior.begin_epoch();
+
+        states.reset_sweep();
+        int choices = Prior::has_punts ? 4 : 3;
+        for (int index = 0; index < NUM_STATES; index++) {
+            if (!valid[index]) continue;
+            double epas[4];
+            for (int play = 0; play < 4; play++) epas[play] = play_terms[index][play].evaluate(x);
+            int opt = std::is_same<Decision, MaxPlay>::value ? policy[index] : std::max_element(epas, epas + choices) - epas;
+            states.set(index, epas[0], epas[1], epas[2], epas[3], x[index], opt);
+        }
+    }
+};
+
+// A converged EP table read back from a simulator's CSV, for lookups (ep_server, pbp_scorer)
+struct EPTable {
+    StateTable states;
+    PropagatedPrior prior;   // first-and-10 EPs, for results that hand the ball over
+    uint32_t version = 0;
+};
+
+// Returns false if the file is missing or does not cover every state (e.g. it is being rewritten)
+bool loadEPTable(const std::string& filename, EPTable& table);
+
+// Successor EPs straight from a loaded table
+struct TableSink {
+    const EPTable& table;
+    double points(double value) const { return value; }
+    double touchdown() const { return table.prior.scoring.touchdown(); }
+    double touchdown_against() const { return -table.prior.scoring.td_val; }
+    double opponent(int yardline) const { return -table.prior.ep(yardline); }
+    double opponent_after(double value, int yardline) const { return value - table.prior.ep(yardline); }
+    double state(int index) const { return table.states.max[index]; }
+};
+
+// Table row of a state, with longer distances played as MAX_DISTANCE like the simulators
+inline int table_state(int down, int distance, int yardline) {
+    return state_index(down, std::min(distance, MAX_DISTANCE), yardline);
+}
+
+// EPA of one sampled result (cdf_data encoding, checked with play_in_range) from the state at index
+// distance is the real one to go: the index's row caps it at MAX_DISTANCE, but a gain short of it is no first down
+inline double table_epa(const EPTable& table, int index, int distance, int outcome) {
+    TableSink sink{table};
+    int yardline = index % NUM_YARDLINES + 1;
+    int down = index / (NUM_YARDLINES * MAX_DISTANCE) + 1;
+    return play_result(table.prior, decode_play(outcome), down, distance, yardline, sink) - table.states.max[index];
+}
+
+#endif
@@ -1,444 +1,282 @@
 #include <iostream>
-#include <fstream>
-#include <unordered_map>
 #include <vector>
-#include <random> 
 #include <chrono>
-#include <sstream>
-#include "json.hpp"
-#include <cstdlib>
+#include "sim_engine.hpp"
+#include "convergence.hpp"
+#include "acceleration.hpp"
+#include "batch_engine.hpp"
 
-using json = nlohmann::json;
 using namespace std;
 
-const int SEED_VALUE = 25;
-const vector<string> play_types = {"rush", "pass"};  // Play types
-
-// Yardline bins (as defined in your new structure)
-const vector<string> yardline_bins = {
-    "1", "2", "3", "4", "5", "6", "7", "8", "9", "10",
-    "11", "12", "13", "14", "15", "16", "17", "18", "19", "20",
-    "21-23", "24-27", "28-32", "33-38", "39-44", "45-50", "51-70", "71-85", "86-99"
-};
-
-// Field Goal Probabilities by yardline position
-const vector<double> fg_prob = {
-    1.0, 0.9875, 1.0, 0.9919, 0.9937, 0.9929, 0.9797, 0.9818, 0.9693, 0.977, 
-    0.9479, 0.983, 0.9777, 0.9459, 0.9659, 0.899, 0.92, 0.9167, 0.9347, 0.893, 
-    0.9053, 0.8603, 0.7956, 0.822, 0.7885, 0.8, 0.7405, 0.7267, 0.7231, 0.6986,
-    0.7394, 0.7416, 0.7216, 0.6911, 0.6994, 0.7059, 0.6129, 0.5595, 0.6271, 0.5297,
-    0.4935, 0.4548, 0.4136, 0.3697, 0.3230, 0.2735, 0.2211, 0.1655, 0.1069, 0.0450,
-    0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0,
-    0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0,
-    0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0
-};
-
-
-
-// Function to generate mapping from yardline (1-99) to index of yardline_bins
-void generateYardlineMapping(vector<int>& yardline_mapping) {
-    yardline_mapping.resize(100, -1); // Initialize with -1 for safety
-
-    for (size_t index = 0; index < yardline_bins.size(); index++) {
-        string bin = yardline_bins[index];
-
-        // Handle individual yardline bins (e.g., "1", "2", ...)
-        if (bin.find('-') == string::npos) {
-            int yardline = stoi(bin);
-            yardline_mapping[yardline] = index;
-        } 
-        // Handle grouped bins (e.g., "21-23", "24-27", ...)
-        else {
-            stringstream ss(bin);
-            int start, end;
-            char dash;
-            ss >> start >> dash >> end;
-            
-            for (int yardline = start; yardline <= end; yardline++) {
-                yardline_mapping[yardline] = index;
-            }
-        }
-    }
-}
-
-
-void loadPriorData(const string& filename, vector<double>& data) {
-    ifstream file(filename);
-    if (!file.is_open()) {
-        cerr << "Error opening file: " << filename << endl;
-        return;
+// Propagated EPs: the best play in every state, with the other team's EPs taken from a prior that is refined
+// epoch by epoch (or solved for directly with --solve)
+typedef Engine<PropagatedPrior, MaxPlay> Simulator;
+
+// Warm starts from a converged table and re-solves only the states whose inputs changed since it was written, and
+// whatever their changes reach; the table's manifest (previous_eps.csv.inputs) says which inputs it was built from
+bool resolve_incremental(Simulator& sim, const string& previous_file, const vector<InputHash>& inputs, double tolerance,
+                         int max_passes, Progress& progress) {
+    vector<InputHash> previous_inputs;
+    EPTable previous;
+    if (!loadInputManifest(previous_file + ".inputs", previous_inputs) || !loadEPTable(previous_file, previous)) {
+        return false;
     }
-
-    // Resize vector to store values for yardline 1 to 99
-    data.assign(99, 0.0);  
-
-    string line;
-    getline(file, line);  // Skip header
-
-    while (getline(file, line)) {
-        stringstream ss(line);
-        int down, distance, yardline, opt_choice;
-        double run_ep, pass_ep, kick_ep, punt_ep, max_ep;
-        char comma;
-    
-        ss >> down >> comma >> distance >> comma >> yardline >> comma
-           >> run_ep >> comma >> pass_ep >> comma >> kick_ep >> comma
-           >> punt_ep >> comma >> max_ep >> comma >> opt_choice;
-    
-        // Store the value only if down == 1 and the specified conditions are met
-        if (down == 1 && ((distance == 10 && yardline >= 10) || (distance == yardline && yardline < 10))) {
-            int index = yardline - 1;  // Convert 1-based yardline to 0-based index
-            data[index] = max_ep;
-        }
-    }    
-    
-
-    file.close();
-    cout << "Successfully loaded prior EP data for " 
-         << count_if(data.begin(), data.end(), [](double v) { return v != 0.0; }) 
-         << " yardlines." << endl;
-}
-
-
-void loadPuntNetYards(vector<vector<int>>& puntYards, const string& filename) {
-    // Open JSON file
-    ifstream file(filename);
-    if (!file) {
-        cerr << "Error opening file: " << filename << endl;
-        return;
+    sim.states = previous.states;
+    sim.prior.prior_epas = previous.prior.prior_epas;
+
+    vector<char> dirty(NUM_STATES, 0);
+    int changed = 0;
+    int num_cdf_files = play_types.size() * yardline_bins.size();
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if (i < previous_inputs.size() && previous_inputs[i] == inputs[i]) continue;
+        cout << "Changed since " << previous_file << ": " << inputs[i].first << endl;
+        sim.mark_bin(((int)i < num_cdf_files) ? (int)i % yardline_bins.size() : -1, dirty);  // punts reach every state
+        changed++;
     }
-
-    json jsonData;
-    file >> jsonData; // Parse JSON
-    file.close();
-
-    // Resize vector to ensure it has 99 elements (index 0 = yardline 1)
-    puntYards.resize(99);
-
-    // Process JSON data
-    for (auto& [key, value] : jsonData.items()) {
-        int yardline = stoi(key);
-        if (yardline >= 1 && yardline <= 99) {
-            int index = yardline - 1; // Convert yardline to 0-based index
-            vector<int> yards = value.get<vector<int>>(); // Extract values
-
-            // If the yardline vector has fewer than 10 elements, make it empty
-            if (yards.size() < 10) {
-                yards.clear();
-            }
-
-            puntYards[index] = yards;
-        }
+    if (changed == 0) {
+        cout << "No inputs changed since " << previous_file << endl;
     }
+    return sim.resolve_incremental(dirty, tolerance, max_passes, progress);
 }
 
-
-// Function to generate filenames dynamically
-vector<string> generateFilenames(string dir_name) {
-    vector<string> filenames;
-    for (const auto& play_type : play_types) {
-        for (const auto& bin : yardline_bins) {
-            filenames.push_back(dir_name + "/" + play_type + "_cdf_yl" + bin + ".json");
-        }
-    }
-    return filenames;
+// Target file of one scenario: target_eps.csv becomes target_eps_<name>.csv
+string scenarioFile(const string& target_file, const string& name) {
+    size_t dot = target_file.rfind('.');
+    size_t slash = target_file.rfind('/');
+    if (dot == string::npos || (slash != string::npos && dot < slash)) return target_file + "_" + name;
+    return target_file.substr(0, dot) + "_" + name + target_file.substr(dot);
 }
 
-// Structure to hold a CDF entry
-struct CDFEntry {
-    vector<int> values;
-    vector<double> cdf;
-};
-
-// Function to load CDF-based JSON into map<string, CDFEntry>
-void loadCDFData(const string& filename, unordered_map<string, CDFEntry>& sample_data) {
-    ifstream file(filename);
-    if (!file) {
-        cerr << "Error opening file: " << filename << endl;
-        return;
-    }
-
-    json jsonData;
-    file >> jsonData;
-
-    for (auto& [key, value] : jsonData.items()) {
-        CDFEntry entry;
-        try {
-            entry.values = value["values"].get<vector<int>>();
-            entry.cdf = value["cdf"].get<vector<double>>();
+// Solves every scenario together and saves one table (and input manifest) per scenario
+bool run_scenarios(BatchEngine& batch, const vector<Scenario>& scenarios, const string& target_file,
+                   const vector<InputHash>& inputs, ThreadPool& pool, double tolerance, int max_epochs,
+                   bool full_precision, Progress& progress) {
+    vector<int> finished = batch.run(pool, tolerance, max_epochs, progress);
+    bool ok = true;
+    for (size_t k = 0; k < scenarios.size(); k++) {
+        string file = scenarioFile(target_file, scenarios[k].name);
+        if (finished[k] < 0) {
+            cout << "Scenario " << scenarios[k].name << ": EPs blew up, not saved" << endl;
+            ok = false;
+            continue;
         }
-        catch (const exception& e){
-            entry.values = vector<int>();
-            entry.values.push_back(value["values"].get<int>());
-            entry.cdf = vector<double>();
-            entry.cdf.push_back(value["cdf"].get<double>());
+        if (finished[k] == 0) {
+            cout << "Scenario " << scenarios[k].name << ": did not converge to " << tolerance << " within " << max_epochs << " epochs";
+        } else {
+            cout << "Scenario " << scenarios[k].name << ": converged after " << finished[k] << " epochs";
         }
-        sample_data[key] = move(entry);
+        cout << ", saved to " << file << endl;
+        saveDataToCSV(file, batch.tables[k], full_precision);
+        saveInputManifest(file + ".inputs", inputs);
     }
-
-    cout << "Loaded CDF data from " << filename << ", " << sample_data.size() << " keys." << endl;
+    return ok;
 }
 
-// Struct for hashing pairs (used for unordered_map keys)
-struct pair_hash {
-    size_t operator()(const pair<string, int>& p) const {
-        return hash<string>()(p.first) ^ hash<int>()(p.second);
-    }
-};
-
-// Function to save results to CSV with separate Down and Distance columns
-void saveDataToCSV(string filename, unordered_map<pair<string, int>, double, pair_hash>& run_data,
-        unordered_map<pair<string, int>, double, pair_hash>& pass_data,
-        unordered_map<pair<string, int>, double, pair_hash>& kick_data,
-        unordered_map<pair<string, int>, double, pair_hash>& punt_data,
-        unordered_map<pair<string, int>, double, pair_hash>& max_data,
-        unordered_map<pair<string, int>, int, pair_hash>& opt_data) {
-    ofstream file(filename);
-    if (!file) {
-        cerr << "Error opening file: " << filename << endl;
-        return;
-    }
-
-    // Write CSV Header
-    file << "Down,Distance,Yardline,Run_EP,Pass_EP,Kick_EP,Punt_EP,EP,Opt_Choice\n";
-
-    // Use run_data as the main loop (should have all keys)
-    for (const auto& [key, run_val] : run_data) {
-        string down_distance = key.first;
-        int yardline = key.second;
-        int down, distance;
+int main(int argc, char* argv[]) {
 
-        size_t dash_pos = down_distance.find('-');
-        if (dash_pos == string::npos) {
-            cerr << "Error parsing Down-Distance format: " << down_distance << endl;
-            continue;
+    // Optional flags: --order gauss-seidel|jacobi|red-black picks the sweep order (Gauss-Seidel by default),
+    // --threads N splits Jacobi and red-black sweeps across N threads (Gauss-Seidel sweeps run on one; the output
+    // never depends on it), --deterministic is accepted and does nothing,
+    // --full-precision saves EPs so they read back exactly,
+    // --progress draws a progress line on stderr, --trace FILE writes every state after every sweep to FILE,
+    // --report FILE saves the per-epoch residuals (max and RMS EP changes, best plays changed) to FILE,
+    // --sor OMEGA or --anderson DEPTH accelerates the prior from epoch to epoch, --incremental PREVIOUS re-solves
+    // only what changed since PREVIOUS (a table this simulator wrote) instead of running epochs,
+    // --solve finds the converged EPs by policy iteration instead of running epochs,
+    // --cache DIR copies the table from DIR if a run with the same inputs and parameters saved one there,
+    // --cold-sweeps starts every epoch's Gauss-Seidel sweep from a zeroed table, as the old one-process-per-epoch
+    // scripts did (a different fixed point, see the README),
+    // --scenarios FILE runs plain epochs for every parameter set in FILE at once and saves target_eps_<name>.csv for
+    // each (--threads splits the scenarios; the other solve, order, acceleration, trace, report and cache flags do not apply)
+    Progress progress;
+    ConvergenceLog convergence;
+    FixedPointAcceleration acceleration;
+    bool full_precision = false;
+    bool solve = false;
+    string previous_file;
+    ResultCache cache;
+    string scenario_file;
+    bool report_given = false;
+    bool cold_sweeps = false;
+    vector<string> args;
+    int num_threads = 1;
+    SweepOrder strategy = GAUSS_SEIDEL;
+    bool order_given = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            num_threads = stoi(argv[++i]);
+        } else if (arg == "--order" && i + 1 < argc) {
+            if (!parseSweepOrder(argv[++i], strategy)) return 1;
+            order_given = true;
+        } else if (arg == "--deterministic") {
+            // No-op: every sweep order already gives the same output for any --threads
+        } else if (arg == "--solve") {
+            solve = true;
+        } else if (arg == "--incremental" && i + 1 < argc) {
+            previous_file = argv[++i];
+        } else if (arg == "--full-precision") {
+            full_precision = true;
+        } else if (arg == "--progress") {
+            progress.use_console();
+        } else if (arg == "--trace" && i + 1 < argc) {
+            if (!progress.open_trace(argv[++i])) return 1;
+        } else if (arg == "--report" && i + 1 < argc) {
+            convergence.set_report(argv[++i]);
+            report_given = true;
+        } else if (arg == "--sor" && i + 1 < argc) {
+            acceleration.use_sor(stod(argv[++i]));
+        } else if (arg == "--anderson" && i + 1 < argc) {
+            acceleration.use_anderson(stoi(argv[++i]));
+        } else if (arg == "--cache" && i + 1 < argc) {
+            if (!cache.use_directory(argv[++i])) return 1;
+        } else if (arg == "--scenarios" && i + 1 < argc) {
+            scenario_file = argv[++i];
+        } else if (arg == "--cold-sweeps") {
+            cold_sweeps = true;
+        } else {
+            args.push_back(arg);
         }
-
-        down = stoi(down_distance.substr(0, dash_pos));
-        distance = stoi(down_distance.substr(dash_pos + 1));
-
-        double pass_val = pass_data[key];
-        double kick_val = kick_data[key];
-        double punt_val = punt_data[key];
-        double max_val = max_data[key];
-        double opt_choice = opt_data[key];
-
-        file << down << "," << distance << "," << yardline << ","
-            << run_val << "," << pass_val << "," << kick_val << "," << punt_val << "," << max_val << "," << opt_choice << "\n";
     }
 
-    file.close();
-    cout << "Combined CSV saved to: " << filename << endl;
-}
-
-const double TD_VAL = 6.945;
-const double FG_VAL = 3;
-double KO_VAL = 0;
-double SKO_VAL = 0; // safety kickoff
-double TB_VAL = 0;
-
-unordered_map<pair<string, int>, double, pair_hash> run_epas;
-unordered_map<pair<string, int>, double, pair_hash> pass_epas;
-unordered_map<pair<string, int>, double, pair_hash> kick_epas;
-unordered_map<pair<string, int>, double, pair_hash> punt_epas;
-unordered_map<pair<string, int>, double, pair_hash> max_epas;
-unordered_map<pair<string, int>, int, pair_hash> opt_choices;
-
-vector<double> probs(100);
-vector<pair<int, int>> distrs(100);
-
-vector<vector<int>> punt_data;
-vector<double> prior_epas;
-
-// Function to compute EPA values based on sampled results
-double get_epa_val(int val, int down, int yards_to_go, int yardline) {
-    if (val < -2000) {
-        int new_yl = 100-(yardline-(val+2100));
-        if(new_yl >= 100){
-            return -TB_VAL;  // Interception touchback
-        } else if(new_yl <= 0){
-            return -TD_VAL;
-        }
-        return -prior_epas[new_yl-1];
+    if(args.size() < 4 || args.size() > 6){
+        cout << "Need to input prior and target ep files, punt yard data, cdf data, and optionally a convergence tolerance and max epochs: " <<
+                    "(./simulator.out prior_eps.csv target_eps.csv punt_net_yards.json cdf_data [tolerance] [max_epochs] [--order gauss-seidel|jacobi|red-black] [--threads N] [--deterministic] [--solve | --incremental previous_eps.csv] [--full-precision] [--progress] [--trace trace.csv] [--report convergence.csv] [--sor omega | --anderson depth] [--cache dir] [--scenarios scenarios.csv] [--cold-sweeps])" << endl;
+        return 1;
     }
 
-    if (val < -1000) {
-        int new_yl = 100-(yardline-(val+1100));
-        if(new_yl >= 100){
-            return -TB_VAL;  // Interception touchback
-        } else if(new_yl <= 0){
-            return -TD_VAL;
-        }
-        return -prior_epas[new_yl-1];
+    string prior_file = args[0]; // refers to exact file
+    string target_file = args[1]; // refers to exact file
+    string punt_data_file = args[2]; // punt_net_yards.json in aux_data
+    string cdf_dir = args[3]; // cdf data directory
+    double tolerance = (args.size() > 4) ? stod(args[4]) : 1e-4; // max change in EPs between epochs
+    int max_epochs = (args.size() > 5) ? stoi(args[5]) : 100;
+    if (!scenario_file.empty() && (solve || !previous_file.empty() || order_given || progress.tracing() ||
+                                   report_given || acceleration.name() != "none" || cache.enabled())) {
+        cerr << "--scenarios runs plain in-place epochs, without --solve, --incremental, --order, --trace, "
+             << "--report, --sor, --anderson or --cache" << endl;
+        return 1;
     }
-
-    int new_yardline = yardline - val;
-    if (new_yardline <= 0) {
-        return TD_VAL - KO_VAL; // Touchdown + Expected Extra Point - EP after kickoff
+    if (cold_sweeps && (solve || !previous_file.empty() || !scenario_file.empty() || strategy != GAUSS_SEIDEL)) {
+        cerr << "--cold-sweeps runs Gauss-Seidel epochs, without --solve, --incremental, --scenarios or another "
+             << "--order" << endl;
+        return 1;
     }
-
-    if (new_yardline >= 100) {
-        return -2 - SKO_VAL;  // Safety - EP after kickoff  (new safety kick rules make it essentially the same as a regular kickoff)
+    // Only the scenarios and Jacobi or red-black epoch sweeps are split across threads
+    if (num_threads > 1 && scenario_file.empty() && (strategy == GAUSS_SEIDEL || solve || !previous_file.empty())) {
+        cerr << "--threads " << num_threads << " has no effect: " << ((solve || !previous_file.empty()) ?
+                "--solve and --incremental run on one thread" :
+                "Gauss-Seidel sweeps run on one thread (--order jacobi or red-black splits its sweeps)") << endl;
     }
+    ThreadPool pool(num_threads);
 
-    int new_down = down + 1;
-    int new_yards_to_go = yards_to_go - val;
+    CDFStore cdf_store;  // JSON directory or packed bundle
 
-    if (new_yards_to_go <= 0) {
-        new_down = 1;
-        new_yards_to_go = (10 <= new_yardline) ? 10 : new_yardline;
-    } else if (new_yards_to_go > 0 && new_down > 4) {
-        return -prior_epas[(100-new_yardline)-1];
+    if (!cdf_store.load(cdf_dir)) {
+        return 1;
     }
 
-    if (new_yards_to_go > 20) new_yards_to_go = 20;
+    cout << "Data loaded successfully!" << endl;
 
-    string new_down_and_distance = to_string(new_down) + "-" + to_string(new_yards_to_go);
-    return max_epas[make_pair(new_down_and_distance, new_yardline)];
-}
+    vector<int> yardline_mapping;
+    vector<vector<int>> punt_data;
+    generateYardlineMapping(yardline_mapping);
+    reportMissingCDFs(cdf_store, yardline_mapping);
+    loadPuntNetYards(punt_data, punt_data_file);
 
-double get_epa_kick_val(int yardline){
-    if(yardline > 60){
-        return -1000;
-    }
-    return fg_prob[yardline-1]*(FG_VAL - KO_VAL) - (1-fg_prob[yardline-1])*prior_epas[100-(yardline+7)-1];
-}
+    Simulator sim(cdf_store, yardline_mapping);
+    sim.prior.punt_profiles = buildPuntProfiles(punt_data);
+    loadPriorData(prior_file, sim.prior.prior_epas);
 
-double get_epa_single_punt(int yardline, int index){
-    int val = punt_data[yardline-1][index];
-    if(val < -1000){
-        return -TD_VAL;
-    }
-    if(val > 1000){
-        int new_yardline = yardline-(val-1000);  // recovered muffed punt
-        if(new_yardline <= 0){
-            return TD_VAL - KO_VAL;
+    cout << "Yardline Mapping Generated!" << endl;
+
+    auto start = chrono::high_resolution_clock::now();
+    vector<InputHash> inputs = inputHashes(cdf_store, punt_data);
+
+    if (!scenario_file.empty()) {
+        vector<Scenario> scenarios;
+        if (!loadScenarios(scenario_file, scenarios)) {
+            return 1;
         }
-        int yl = (new_yardline < 10) ? new_yardline : 10;
-        return prior_epas[new_yardline-1];
-    }
+        BatchEngine batch(cdf_store, yardline_mapping, sim.prior, scenarios);
+        bool ok = run_scenarios(batch, scenarios, target_file, inputs, pool, tolerance, max_epochs, full_precision, progress);
 
-    if(yardline-val <= 0){
-        return -TB_VAL;
+        auto end = chrono::high_resolution_clock::now();
+        cout << "Execution time: " << chrono::duration<double>(end - start).count() << " seconds" << endl;
+        return ok ? 0 : 1;
     }
 
-    if ((100-(yardline-val))-1 <= 0) return -TD_VAL; // Because of error in punt data
-    return -prior_epas[(100-(yardline-val))-1];   // Other team gets ball
-}
-
-double get_epa_punt_val(int yardline){
-    int num_punts = punt_data[yardline-1].size();
-    if(num_punts == 0){
-        return -1000;  // too close, never punting
+    // Everything the table depends on; an incremental run also depends on the table it starts from, so it always
+    // re-solves, and a traced run always solves so there is a trace
+    cache.add("program", "simulator");
+    cache.add("prior", sim.prior.prior_epas);
+    addModelToCacheKey(cache, inputs, fg_prob);
+    cache.add("method", solve ? "solve" : "epochs");
+    if (!solve) {
+        cache.add("tolerance", tolerance);
+        cache.add("max_epochs", max_epochs);
+        cache.add("order", sweepOrderName(strategy));
+        if (cold_sweeps) cache.add("sweeps", "cold");
+        cache.add("sor_omega", acceleration.relaxation());
+        cache.add("anderson_depth", acceleration.history());
     }
-    double epa_val = 0.0;
-    for(int i = 0; i<num_punts; i++){
-        epa_val += get_epa_single_punt(yardline, i);
+    cache.add("full_precision", full_precision ? 1 : 0);
+    if (previous_file.empty() && !progress.tracing() && cache.fetch(target_file, solve ? "" : convergence.report())) {
+        saveInputManifest(target_file + ".inputs", inputs);
+        return 0;
     }
 
-    return epa_val/num_punts;
-}
-
-// Run the simulation
-void run_simulation(vector<unordered_map<string, CDFEntry>>& cdf_datas, vector<int>& yardline_mapping) {
-    uniform_real_distribution<double> dist(0.0, 1.0);
-
-    int yardline;
-    int down;
-    int yards_to_go;
-
-    for (yardline = 1; yardline < 100; yardline++) {
-        for (down = 4; down > 0; down--) {
-            for (yards_to_go = 1; yards_to_go <= 20; yards_to_go++) {
-                if (yards_to_go > yardline) continue;            // Can't have first and 10 from 5 yard line
-
-                string down_and_distance = to_string(down) + "-" + to_string(yards_to_go);
-                double epa_rush_val = 0;
-                double epa_pass_val = 0;
-                double epa_kick_val = (down == 4) ? get_epa_kick_val(yardline) : -1000;  // only viable if it is 4th down
-                // double epa_punt_val = (down == 4) ? get_epa_punt_val(yardline, mt1) : -1000;
-                double epa_punt_val = get_epa_punt_val(yardline);
-
-                int sample_num;
-                // int sample_num = (dist(mt1) < probs[yardline - 1]) ? distrs[yardline - 1].second : distrs[yardline - 1].first;
-                sample_num = yardline_mapping[yardline];
-                CDFEntry cdf;
-
-                epa_rush_val = 0;
-                epa_pass_val = 0;
-
-                cdf = cdf_datas[sample_num][down_and_distance];
-                double prev = 0.0;
-                for (int i = 0; i < cdf.values.size(); i++) {
-                    epa_rush_val += (cdf.cdf[i]-prev) * get_epa_val(cdf.values[i], down, yards_to_go, yardline);
-                    prev = cdf.cdf[i];
-                }
-                cdf = cdf_datas[yardline_bins.size()+sample_num][down_and_distance];
-                prev = 0.0;
-                for (int i = 0; i < cdf.values.size(); i++) {
-                    epa_pass_val += (cdf.cdf[i]-prev) * get_epa_val(cdf.values[i], down, yards_to_go, yardline);
-                    prev = cdf.cdf[i];
-                }
-
-                if (epa_rush_val > 1e10 || epa_pass_val > 1e10 || epa_rush_val<=-1e6) {
-                    cerr << down_and_distance << " " << yardline << ": Large EPAs encounted (Re-run program): " << epa_rush_val << ", " << epa_pass_val << endl;
-                    exit(1);
-                }
-
-                pair<string, int> ddy = make_pair(down_and_distance, yardline);
-
-                run_epas[ddy] = epa_rush_val;
-                pass_epas[ddy] = epa_pass_val;
-                kick_epas[ddy] = epa_kick_val;
-                punt_epas[ddy] = epa_punt_val;
-                max_epas[ddy] = max({epa_rush_val, epa_pass_val, epa_kick_val, epa_punt_val});
-                
-                vector<double> epas = {epa_rush_val, epa_pass_val, epa_kick_val, epa_punt_val};
-                int max_index = distance(epas.begin(), max_element(epas.begin(), epas.end()));
-                opt_choices[ddy] = max_index;
-
-                cout << down_and_distance << " " << yardline << ": " << epa_rush_val << ", " << epa_pass_val << ", " << epa_kick_val << ", " << epa_punt_val << endl;
-            }
+    if (solve || !previous_file.empty()) {
+        if (solve ? !sim.solve(progress) : !resolve_incremental(sim, previous_file, inputs, tolerance, max_epochs, progress)) {
+            return 1;
         }
+        progress.trace_sweep(1, sim.states);
+        saveDataToCSV(target_file, sim.states, full_precision);
+        saveInputManifest(target_file + ".inputs", inputs);
+        if (previous_file.empty()) cache.store(target_file);
+
+        auto end = chrono::high_resolution_clock::now();
+        cout << "Execution time: " << chrono::duration<double>(end - start).count() << " seconds" << endl;
+        return 0;
     }
-}
 
-int main(int argc, char* argv[]) {
+    // Each epoch uses the previous epoch's EPs as the prior, all in memory
+    // (or, with --sor or --anderson, an accelerated mix of them)
+    convergence.start(sim.states);
+    cout << "Prior acceleration: " << acceleration.name() << endl;
+    int epoch;
+    for (epoch = 1; epoch <= max_epochs; epoch++) {
+        sim.prior.begin_epoch();
+        vector<double> start_max = sim.states.max;
+        vector<double> prior = sim.prior.prior_epas;
+        sim.sweep(pool, strategy, cold_sweeps);
+        sim.prior.update(sim.states);
+        EpochResiduals residuals = convergence.record(epoch, start_max, sim.states, prior, sim.prior.prior_epas);
+        progress.trace_sweep(epoch, sim.states);
+
+        // Jacobi sweeps move the table less per epoch, so converge on the whole table as well as the prior
+        double change = max(residuals.max_ep_change, residuals.max_prior_change);
+
+        if (change < tolerance) {
+            progress.report("Epoch", epoch, epoch);
+            break;
+        }
+        progress.report("Epoch", epoch, max_epochs);
 
-    if(argc != 5){
-        cout << "Need to input prior and target ep files, punt yard data, cdf data: (./simulator.out prior_eps.csv target_eps.csv punt_net_yards.json cdf_data)" << endl;
-        return 1;
+        // The next epoch starts from an accelerated table, and its prior follows
+        if (acceleration.next(start_max, sim.states.max)) sim.prior.update(sim.states);
     }
 
-    string prior_file = argv[1]; // refers to exact file
-    string target_file = argv[2]; // refers to exact file
-    string punt_data_file = argv[3]; // punt_net_yards.json in aux_data
-    string cdf_dir = argv[4]; // cdf data directory
-
-    vector<string> filenames = generateFilenames(cdf_dir);  // Generate filenames dynamically
-    vector<unordered_map<string, CDFEntry>> cdf_datas(filenames.size());
-
-    for (size_t i = 0; i < filenames.size(); i++) {
-        loadCDFData(filenames[i], cdf_datas[i]);
+    if (epoch > max_epochs) {
+        cout << "Did not converge to " << tolerance << " within " << max_epochs << " epochs" << endl;
+    } else {
+        cout << "Converged after " << epoch << " epochs" << endl;
     }
+    convergence.finish(epoch <= max_epochs);
 
-    cout << "Data loaded successfully!" << endl;
-
-    vector<int> yardline_mapping;
-    generateYardlineMapping(yardline_mapping);
-    loadPuntNetYards(punt_data, punt_data_file);
-
-    loadPriorData(prior_file, prior_epas);
-
-    KO_VAL = 0; // prior_epas[70-1];  // 0 for biased (mimicing nflfastr ep calculations)
-    SKO_VAL = prior_epas[70-1];
-    TB_VAL = prior_epas[80-1];
-
-    cout << "Yardline Mapping Generated!" << endl;
-
-    auto start = chrono::high_resolution_clock::now();
-    run_simulation(cdf_datas, yardline_mapping);
-    saveDataToCSV(target_file, run_epas, pass_epas, kick_epas, punt_epas, max_epas, opt_choices);
+    saveDataToCSV(target_file, sim.states, full_precision);
+    saveInputManifest(target_file + ".inputs", inputs);
+    cache.store(target_file, convergence.report());
 
     auto end = chrono::high_resolution_clock::now();
     cout << "Execution time: " << chrono::duration<double>(end - start).count() << " seconds" << endl;
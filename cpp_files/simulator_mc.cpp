@@ -0,0 +1,473 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <array>
+#include <chrono>
+#include <sstream>
+#include <cmath>
+#include "json.hpp"
+#include "sim_engine.hpp"
+#include "counter_rng.hpp"
+
+using json = nlohmann::json;
+using namespace std;
+
+// Monte Carlo drive simulator: plays whole possessions chains from the raw yardage samples in distr_data,
+// choosing plays by the Opt_Choice column of an EP file, until the next score. Every game is one stream of a
+// counter-based generator keyed by (seed, start state, game), so results do not depend on the thread count
+
+const int SEED_VALUE = 25;
+
+const int GAMES_PER_BATCH = 4096;         // games per work item, the unit results are merged in
+const int MAX_PLAYS_PER_GAME = 10000;     // a game still going after this many plays is cut off with its points so far
+const double CI_Z = 1.959963984540054;    // 95% normal confidence interval
+
+// How the first possession of a game ended
+enum DriveOutcome { TOUCHDOWN, FIELD_GOAL, MISSED_FG, PUNT, DOWNS, INTERCEPTION, FUMBLE, SAFETY, NUM_DRIVE_OUTCOMES };
+const char* drive_outcome_names[NUM_DRIVE_OUTCOMES] = {
+    "Touchdown", "Field_Goal", "Missed_FG", "Punt", "Downs", "Interception", "Fumble", "Safety"
+};
+
+// Raw rush/pass yardage samples, decoded and flattened with an offset/size slot per (play type, bin, down, distance)
+struct SampleStore {
+    vector<PlayOutcome> outcomes;
+    vector<uint32_t> offset;
+    vector<uint32_t> size;
+    int max_distance = 0;
+
+    size_t slot_index(int play_type, int bin, int down, int distance) const {
+        return (((size_t)play_type * yardline_bins.size() + bin) * 4 + (down - 1)) * MAX_DISTANCE + (distance - 1);
+    }
+};
+
+bool loadSamples(const string& dir_name, SampleStore& store) {
+    size_t num_slots = play_types.size() * yardline_bins.size() * 4 * MAX_DISTANCE;
+    store.outcomes.clear();
+    store.offset.assign(num_slots, 0);
+    store.size.assign(num_slots, 0);
+    store.max_distance = 0;
+    long skipped = 0;
+
+    for (size_t play_type = 0; play_type < play_types.size(); play_type++) {
+        for (size_t bin = 0; bin < yardline_bins.size(); bin++) {
+            string filename = dir_name + "/" + play_types[play_type] + "_distributions_yl" + yardline_bins[bin] + ".json";
+            ifstream file(filename);
+            if (!file) {
+                cerr << "Error opening file: " << filename << endl;
+                return false;
+            }
+
+            json jsonData;
+            file >> jsonData;
+
+            for (auto& [key, value] : jsonData.items()) {
+                int down, distance;
+                if (sscanf(key.c_str(), "%d-%d", &down, &distance) != 2 || down < 1 || down > 4 || distance < 1) {
+                    cerr << "Skipping bad down-distance key " << key << " in " << filename << endl;
+                    continue;
+                }
+                if (distance > MAX_DISTANCE) continue;  // off the state grid
+
+                // R writes missing yardage as "NA", which is left out
+                vector<PlayOutcome> samples;
+                for (const auto& sample : (value.is_array() ? value : json::array({value}))) {
+                    if (sample.is_number()) {
+                        int32_t val = sample.get<int32_t>();
+                        if (!play_in_range(val)) {
+                            cerr << "Sample " << val << " for " << key << " in " << filename << " is out of range" << endl;
+                            return false;
+                        }
+                        samples.push_back(decode_play(val));
+                    } else {
+                        skipped++;
+                    }
+                }
+
+                size_t slot = store.slot_index(play_type, bin, down, distance);
+                store.offset[slot] = store.outcomes.size();
+                store.size[slot] = samples.size();
+                store.outcomes.insert(store.outcomes.end(), samples.begin(), samples.end());
+                store.max_distance = max(store.max_distance, distance);
+            }
+        }
+    }
+
+    cout << "Loaded " << store.outcomes.size() << " yardage samples from " << dir_name << " (" << skipped << " NA skipped)" << endl;
+    return true;
+}
+
+// Opt_Choice (0 run, 1 pass, 2 kick, 3 punt) and EP of every state in an EP file
+// States missing from the file pass
+bool loadPolicy(const string& filename, vector<int>& policy, vector<double>& model_ep) {
+    ifstream file(filename);
+    if (!file.is_open()) {
+        cerr << "Error opening file: " << filename << endl;
+        return false;
+    }
+
+    policy.assign(NUM_STATES, 1);
+    model_ep.assign(NUM_STATES, 0.0);
+
+    string line;
+    getline(file, line);  // Skip header
+
+    int count = 0;
+    while (getline(file, line)) {
+        stringstream ss(line);
+        int down, distance, yardline, opt_choice;
+        double run_ep, pass_ep, kick_ep, punt_ep, max_ep;
+        char comma;
+
+        ss >> down >> comma >> distance >> comma >> yardline >> comma
+           >> run_ep >> comma >> pass_ep >> comma >> kick_ep >> comma
+           >> punt_ep >> comma >> max_ep >> comma >> opt_choice;
+
+        if (!ss || down < 1 || down > 4 || distance < 1 || distance > MAX_DISTANCE || yardline < 1 || yardline > NUM_YARDLINES) continue;
+        if (opt_choice < 0 || opt_choice > 3) continue;
+
+        int index = state_index(down, distance, yardline);
+        policy[index] = opt_choice;
+        model_ep[index] = max_ep;
+        count++;
+    }
+
+    cout << "Loaded plays for " << count << " states from " << filename << endl;
+    return true;
+}
+
+// Running totals for the games from one start state, merged across batches in a fixed order
+struct MCStats {
+    long games = 0;
+    double mean = 0.0;
+    double m2 = 0.0;       // sum of squared deviations from the mean
+    long plays = 0;        // plays in first possessions
+    long total_plays = 0;  // plays in whole games
+    long truncated = 0;
+    array<long, NUM_DRIVE_OUTCOMES> outcomes{};
+
+    void add(double value) {
+        games++;
+        double delta = value - mean;
+        mean += delta / games;
+        m2 += delta * (value - mean);
+    }
+
+    // Chan et al. pairwise update
+    void merge(const MCStats& other) {
+        if (other.games == 0) return;
+        long combined = games + other.games;
+        double delta = other.mean - mean;
+        mean += delta * other.games / combined;
+        m2 += other.m2 + delta * delta * ((double)games * other.games / combined);
+        games = combined;
+        plays += other.plays;
+        total_plays += other.total_plays;
+        truncated += other.truncated;
+        for (int i = 0; i < NUM_DRIVE_OUTCOMES; i++) outcomes[i] += other.outcomes[i];
+    }
+
+    double std_dev() const { return (games > 1) ? sqrt(m2 / (games - 1)) : 0.0; }
+};
+
+SampleStore samples;
+vector<vector<PuntOutcome>> punts_by_yardline;
+vector<int> policy;
+vector<double> model_ep;
+vector<int> yardline_mapping;
+
+// Plays one game from (down, yards_to_go, yardline) until the next score
+// Returns the points of that score for the starting offense (negative if the other team scores)
+double play_game(int down, int yards_to_go, int yardline, CounterRNG& rng, MCStats& stats) {
+    double value = 0.0;
+    double sign = 1.0;        // +1 while the starting offense has the ball
+    bool first_drive = true;
+    int plays = 0;
+
+    // Ends the current possession, the other team takes over at yardline (from their own goal line)
+    auto change_possession = [&](int new_yardline, DriveOutcome outcome) {
+        if (first_drive) {
+            stats.outcomes[outcome]++;
+            stats.plays += plays;
+            first_drive = false;
+        }
+        sign = -sign;
+        down = 1;
+        yardline = new_yardline;
+        yards_to_go = (yardline < 10) ? yardline : 10;
+    };
+
+    auto score = [&](double points, DriveOutcome outcome) {
+        value += sign * points;
+        if (first_drive) {
+            stats.outcomes[outcome]++;
+            stats.plays += plays;
+            first_drive = false;
+        }
+    };
+
+    bool finished = false;  // left through a score, not cut off at MAX_PLAYS_PER_GAME
+    while (plays < MAX_PLAYS_PER_GAME) {
+        plays++;
+        int choice = policy[state_index(down, yards_to_go, yardline)];
+
+        if (choice == 2) {
+            if (rng.uniform() < fg_prob[yardline-1]) {
+                score(FG_VAL, FIELD_GOAL);
+                finished = true;
+                break;
+            }
+            if (yardline+7 >= 100) {
+                // Missed from inside their own 7 (never chosen by simulator.cpp's plays): treated as a safety
+                value -= sign * 2;
+                change_possession(70, MISSED_FG);
+                continue;
+            }
+            change_possession(100-(yardline+7), MISSED_FG);
+            continue;
+        }
+
+        if (choice == 3) {
+            const vector<PuntOutcome>& punts = punts_by_yardline[yardline-1];
+            if (punts.empty()) {
+                change_possession(80, PUNT);  // too few punts recorded from here, call it a touchback
+                continue;
+            }
+            PuntOutcome punt = punts[rng.below(punts.size())];
+            if (punt.kind == PUNT_RETURN_TD) {
+                value -= sign * TD_VAL;
+                if (first_drive) {
+                    stats.outcomes[PUNT]++;
+                    stats.plays += plays;
+                }
+                finished = true;
+                break;
+            }
+            if (punt.kind == PUNT_MUFF_TD) {
+                score(TD_VAL, TOUCHDOWN);
+                finished = true;
+                break;
+            }
+            if (punt.kind == PUNT_MUFF_RECOVERED) {
+                down = 1;
+                yardline = punt.yardline;
+                yards_to_go = (yardline < 10) ? yardline : 10;
+                continue;
+            }
+            change_possession((punt.kind == PUNT_TOUCHBACK) ? 80 : punt.yardline, PUNT);
+            continue;
+        }
+
+        // Rush or pass, distances past the sampled grid use the longest one sampled
+        int sample_distance = min(yards_to_go, samples.max_distance);
+        size_t slot = samples.slot_index(choice, yardline_mapping[yardline], down, sample_distance);
+        uint32_t num_samples = samples.size[slot];
+        PlayOutcome sample = (num_samples > 0) ? samples.outcomes[samples.offset[slot] + rng.below(num_samples)]
+                                               : PlayOutcome{0, PLAY_GAIN};
+
+        if (sample.turnover()) {
+            int new_yl = 100-(yardline-sample.yards);
+            DriveOutcome outcome = (sample.kind == PLAY_INTERCEPTION) ? INTERCEPTION : FUMBLE;
+            if (new_yl <= 0) {
+                value -= sign * TD_VAL;  // returned for a touchdown
+                if (first_drive) {
+                    stats.outcomes[outcome]++;
+                    stats.plays += plays;
+                }
+                finished = true;
+                break;
+            }
+            change_possession((new_yl >= 100) ? 80 : new_yl, outcome);  // touchback at 100 or beyond
+            continue;
+        }
+
+        int val = sample.yards;
+        int new_yardline = yardline - val;
+        if (new_yardline <= 0) {
+            score(TD_VAL, TOUCHDOWN);
+            finished = true;
+            break;
+        }
+
+        if (new_yardline >= 100) {
+            value -= sign * 2;  // Safety, then the other team receives the safety kick
+            change_possession(70, SAFETY);
+            continue;
+        }
+
+        int new_down = down + 1;
+        int new_yards_to_go = yards_to_go - val;
+
+        if (new_yards_to_go <= 0) {
+            new_down = 1;
+            new_yards_to_go = (10 <= new_yardline) ? 10 : new_yardline;
+        } else if (new_down > 4) {
+            change_possession(100-new_yardline, DOWNS);
+            continue;
+        }
+
+        if (new_yards_to_go > MAX_DISTANCE) new_yards_to_go = MAX_DISTANCE;
+
+        down = new_down;
+        yards_to_go = new_yards_to_go;
+        yardline = new_yardline;
+    }
+
+    if (!finished) stats.truncated++;
+    stats.total_plays += plays;
+    return value;
+}
+
+struct MCBatch {
+    int state;
+    long first_game;
+    int count;
+};
+
+void saveResultsToCSV(const string& filename, const vector<int>& start_states, const vector<MCStats>& results) {
+    CSVWriter file;
+    if (!file.open(filename)) {
+        return;
+    }
+
+    string header = "Down,Distance,Yardline,Games,EP,Std_Dev,CI_Low,CI_High,Model_EP,Plays_Per_Drive";
+    for (const char* name : drive_outcome_names) header += string(",") + name;
+    file.line(header.c_str());
+
+    for (size_t i = 0; i < start_states.size(); i++) {
+        int index = start_states[i];
+        const MCStats& stats = results[i];
+        double half_width = CI_Z * stats.std_dev() / sqrt((double)max(stats.games, 1L));
+
+        file.field(index / (NUM_YARDLINES * MAX_DISTANCE) + 1);
+        file.field((index / NUM_YARDLINES) % MAX_DISTANCE + 1);
+        file.field(index % NUM_YARDLINES + 1);
+        file.field(stats.games);
+        file.field(stats.mean);
+        file.field(stats.std_dev());
+        file.field(stats.mean - half_width);
+        file.field(stats.mean + half_width);
+        file.field(model_ep[index]);
+        file.field((double)stats.plays / max(stats.games, 1L));
+        for (int outcome = 0; outcome < NUM_DRIVE_OUTCOMES; outcome++) {
+            file.field((double)stats.outcomes[outcome] / max(stats.games, 1L));
+        }
+        file.end_row();
+    }
+
+    if (!file.close()) {
+        cerr << "Error writing file: " << filename << endl;
+        return;
+    }
+    cout << "Monte Carlo CSV saved to: " << filename << endl;
+}
+
+int main(int argc, char* argv[]) {
+
+    // Optional flags: --threads N plays games on N threads, --first-downs only starts games from the first-and-10
+    // (or goal-to-go) states, --progress draws a progress line on stderr
+    Progress progress;
+    vector<string> args;
+    int num_threads = 1;
+    bool first_downs = false;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--threads" && i + 1 < argc) {
+            num_threads = stoi(argv[++i]);
+        } else if (arg == "--first-downs") {
+            first_downs = true;
+        } else if (arg == "--progress") {
+            progress.use_console();
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    if(args.size() < 4 || args.size() > 6){
+        cout << "Need to input an EP file to take plays from, punt yard data, raw distribution data, an output file, and optionally games per start state and a seed: " <<
+                    "(./simulator_mc.out final_eps.csv punt_net_yards.json distr_data mc_eps.csv [games_per_state] [seed] [--threads N] [--first-downs] [--progress])" << endl;
+        return 1;
+    }
+
+    string policy_file = args[0];
+    string punt_data_file = args[1];
+    string distr_dir = args[2];
+    string target_file = args[3];
+    long games_per_state = (args.size() > 4) ? stol(args[4]) : 10000;
+    uint64_t seed = (args.size() > 5) ? stoull(args[5]) : SEED_VALUE;
+    ThreadPool pool(num_threads);
+
+    if (!loadSamples(distr_dir, samples) || !loadPolicy(policy_file, policy, model_ep)) {
+        return 1;
+    }
+    vector<vector<int>> punt_data;
+    loadPuntNetYards(punt_data, punt_data_file);
+    punts_by_yardline = decodePunts(punt_data);
+    generateYardlineMapping(yardline_mapping);
+
+    cout << "Data loaded successfully!" << endl;
+
+    vector<int> start_states;
+    for (int down = 1; down <= 4; down++) {
+        for (int distance = 1; distance <= MAX_DISTANCE; distance++) {
+            for (int yardline = 1; yardline <= NUM_YARDLINES; yardline++) {
+                if (distance > yardline) continue;
+                if (first_downs && (down != 1 || distance != ((yardline < 10) ? yardline : 10))) continue;
+                start_states.push_back(state_index(down, distance, yardline));
+            }
+        }
+    }
+
+    vector<MCBatch> batches;
+    for (size_t i = 0; i < start_states.size(); i++) {
+        for (long game = 0; game < games_per_state; game += GAMES_PER_BATCH) {
+            batches.push_back({(int)i, game, (int)min<long>(GAMES_PER_BATCH, games_per_state - game)});
+        }
+    }
+
+    auto start = chrono::high_resolution_clock::now();
+
+    // Batches run in rounds so progress can be reported between them, and results merge in batch order
+    vector<MCStats> results(start_states.size());
+    vector<MCStats> batch_stats;
+    int round_size = pool.size() * 16;
+    for (size_t round_start = 0; round_start < batches.size(); round_start += round_size) {
+        int round_count = min<size_t>(round_size, batches.size() - round_start);
+        batch_stats.assign(round_count, MCStats());
+        pool.parallel_for(round_count, [&](int begin, int end) {
+            for (int b = begin; b < end; b++) {
+                const MCBatch& batch = batches[round_start + b];
+                int index = start_states[batch.state];
+                int down = index / (NUM_YARDLINES * MAX_DISTANCE) + 1;
+                int distance = (index / NUM_YARDLINES) % MAX_DISTANCE + 1;
+                int yardline = index % NUM_YARDLINES + 1;
+                for (long game = batch.first_game; game < batch.first_game + batch.count; game++) {
+                    CounterRNG rng(seed, ((uint64_t)index << 40) | (uint64_t)game);
+                    batch_stats[b].add(play_game(down, distance, yardline, rng, batch_stats[b]));
+                }
+            }
+        });
+        for (int b = 0; b < round_count; b++) {
+            results[batches[round_start + b].state].merge(batch_stats[b]);
+        }
+        progress.report("Batch", round_start + round_count, batches.size());
+    }
+
+    auto end = chrono::high_resolution_clock::now();
+    double seconds = chrono::duration<double>(end - start).count();
+
+    long total_games = 0, total_plays = 0, truncated = 0;
+    for (const MCStats& stats : results) {
+        total_games += stats.games;
+        total_plays += stats.total_plays;
+        truncated += stats.truncated;
+    }
+    cout << "Simulated " << total_games << " games, " << total_plays << " plays in " << seconds << " seconds ("
+         << total_plays / max(seconds, 1e-9) << " plays/s)" << endl;
+    if (truncated > 0) {
+        cout << truncated << " games cut off after " << MAX_PLAYS_PER_GAME << " plays" << endl;
+    }
+
+    saveResultsToCSV(target_file, start_states, results);
+
+    return 0;
+}
@@ -0,0 +1,167 @@
+#ifndef SPARSE_SOLVER_HPP
+#define SPARSE_SOLVER_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+// constant + sum of weight * x[index], for writing a state's EP in terms of other states' EPs
+struct LinearExpr {
+    double constant = 0.0;
+    std::vector<std::pair<int, double>> terms;
+
+    void add(double value) { constant += value; }
+    void add(int index, double weight) { terms.push_back({index, weight}); }
+    void add(const LinearExpr& expr, double weight) {
+        constant += weight * expr.constant;
+        for (const auto& [index, w] : expr.terms) terms.push_back({index, weight * w});
+    }
+
+    // Sorts by index and merges repeated indices
+    void compress() {
+        std::sort(terms.begin(), terms.end());
+        size_t out = 0;
+        for (size_t i = 0; i < terms.size(); i++) {
+            if (out > 0 && terms[out - 1].first == terms[i].first) {
+                terms[out - 1].second += terms[i].second;
+            } else {
+                terms[out++] = terms[i];
+            }
+        }
+        terms.resize(out);
+    }
+
+    double evaluate(const std::vector<double>& x) const {
+        double value = constant;
+        for (const auto& [index, weight] : terms) value += weight * x[index];
+        return value;
+    }
+};
+
+// Square matrix in compressed sparse row form
+struct SparseMatrix {
+    int rows = 0;
+    std::vector<int> row_start{0};
+    std::vector<int> cols;
+    std::vector<double> vals;
+
+    // Rows are appended in order, each with sorted, unique columns
+    void add_row(const std::vector<std::pair<int, double>>& entries) {
+        for (const auto& [col, val] : entries) {
+            cols.push_back(col);
+            vals.push_back(val);
+        }
+        row_start.push_back(cols.size());
+        rows++;
+    }
+
+    void multiply(const std::vector<double>& x, std::vector<double>& y) const {
+        y.resize(rows);
+        for (int r = 0; r < rows; r++) {
+            double sum = 0.0;
+            for (int k = row_start[r]; k < row_start[r + 1]; k++) sum += vals[k] * x[cols[k]];
+            y[r] = sum;
+        }
+    }
+
+    double diagonal(int r) const {
+        for (int k = row_start[r]; k < row_start[r + 1]; k++) {
+            if (cols[k] == r) return vals[k];
+        }
+        return 0.0;
+    }
+};
+
+// Builds A = I - M and b from x = b + M x, one expression per row (already compressed)
+inline void build_fixed_point_system(const std::vector<LinearExpr>& rows, SparseMatrix& A, std::vector<double>& b) {
+    A = SparseMatrix();
+    b.assign(rows.size(), 0.0);
+    std::vector<std::pair<int, double>> entries;
+    for (size_t r = 0; r < rows.size(); r++) {
+        entries.clear();
+        bool diagonal_added = false;
+        for (const auto& [index, weight] : rows[r].terms) {
+            if (!diagonal_added && index >= (int)r) {
+                if (index == (int)r) {
+                    entries.push_back({index, 1.0 - weight});
+                    diagonal_added = true;
+                    continue;
+                }
+                entries.push_back({(int)r, 1.0});
+                diagonal_added = true;
+            }
+            entries.push_back({index, -weight});
+        }
+        if (!diagonal_added) entries.push_back({(int)r, 1.0});
+        A.add_row(entries);
+        b[r] = rows[r].constant;
+    }
+}
+
+// Jacobi-preconditioned BiCGSTAB for A x = b, starting from the x passed in
+// Returns the iterations used, or -1 if the relative residual did not reach tolerance
+inline int solve_bicgstab(const SparseMatrix& A, const std::vector<double>& b, std::vector<double>& x,
+                          double tolerance, int max_iterations, double* final_residual = nullptr) {
+    int n = A.rows;
+    auto dot = [n](const std::vector<double>& u, const std::vector<double>& v) {
+        double sum = 0.0;
+        for (int i = 0; i < n; i++) sum += u[i] * v[i];
+        return sum;
+    };
+
+    std::vector<double> inv_diag(n);
+    for (int i = 0; i < n; i++) {
+        double d = A.diagonal(i);
+        inv_diag[i] = (d != 0.0) ? 1.0 / d : 1.0;
+    }
+
+    std::vector<double> r(n), r_hat(n), p(n, 0.0), v(n, 0.0), s(n), t(n), p_hat(n), s_hat(n);
+    x.resize(n, 0.0);
+    A.multiply(x, r);
+    for (int i = 0; i < n; i++) r[i] = b[i] - r[i];
+    r_hat = r;
+
+    double b_norm = std::sqrt(dot(b, b));
+    if (b_norm == 0.0) b_norm = 1.0;
+    double residual = std::sqrt(dot(r, r)) / b_norm;
+    if (final_residual) *final_residual = residual;
+    if (residual < tolerance) return 0;
+
+    double rho = 1.0, alpha = 1.0, omega = 1.0;
+    for (int iteration = 1; iteration <= max_iterations; iteration++) {
+        double rho_next = dot(r_hat, r);
+        if (rho_next == 0.0) break;  // breakdown
+        double beta = (rho_next / rho) * (alpha / omega);
+        rho = rho_next;
+        for (int i = 0; i < n; i++) p[i] = r[i] + beta * (p[i] - omega * v[i]);
+
+        for (int i = 0; i < n; i++) p_hat[i] = inv_diag[i] * p[i];
+        A.multiply(p_hat, v);
+        alpha = rho / dot(r_hat, v);
+        for (int i = 0; i < n; i++) s[i] = r[i] - alpha * v[i];
+
+        residual = std::sqrt(dot(s, s)) / b_norm;
+        if (residual < tolerance) {
+            for (int i = 0; i < n; i++) x[i] += alpha * p_hat[i];
+            if (final_residual) *final_residual = residual;
+            return iteration;
+        }
+
+        for (int i = 0; i < n; i++) s_hat[i] = inv_diag[i] * s[i];
+        A.multiply(s_hat, t);
+        omega = dot(t, s) / dot(t, t);
+        for (int i = 0; i < n; i++) {
+            x[i] += alpha * p_hat[i] + omega * s_hat[i];
+            r[i] = s[i] - omega * t[i];
+        }
+
+        residual = std::sqrt(dot(r, r)) / b_norm;
+        if (final_residual) *final_residual = residual;
+        if (residual < tolerance) return iteration;
+        if (omega == 0.0) break;
+    }
+    return -1;
+}
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef STATE_TABLE_HPP
+#define STATE_TABLE_HPP
+
+#include <algorithm>
+#include <vector>
+
+// Game states are (down, distance, yardline): 4 downs, distance 1..MAX_DISTANCE, yardline 1..99
+// Build with -DMAX_DISTANCE=40 for a deeper distance grid
+#ifndef MAX_DISTANCE
+#define MAX_DISTANCE 20
+#endif
+
+const int NUM_DOWNS = 4;
+const int NUM_YARDLINES = 99;
+const int NUM_STATES = NUM_DOWNS * MAX_DISTANCE * NUM_YARDLINES;
+
+// Flat index of a state, yardline varies fastest
+inline int state_index(int down, int distance, int yardline) {
+    return ((down - 1) * MAX_DISTANCE + (distance - 1)) * NUM_YARDLINES + (yardline - 1);
+}
+
+// Per-state results for one sweep, one contiguous array per column
+struct StateTable {
+    std::vector<double> run;
+    std::vector<double> pass;
+    std::vector<double> kick;
+    std::vector<double> punt;
+    std::vector<double> max;
+    std::vector<int> opt;
+    std::vector<char> computed;  // state has been written at least once (these are the rows saved to CSV)
+    std::vector<char> visited;   // simulator_norm: state entered during the current sweep
+    std::vector<double> prior;   // simulator_norm: previous sweep's max, used to break cycles
+
+    StateTable()
+        : run(NUM_STATES, 0.0), pass(NUM_STATES, 0.0), kick(NUM_STATES, 0.0), punt(NUM_STATES, 0.0),
+          max(NUM_STATES, 0.0), opt(NUM_STATES, 0), computed(NUM_STATES, 0), visited(NUM_STATES, 0),
+          prior(NUM_STATES, 0.0) {}
+
+    void set(int index, double run_val, double pass_val, double kick_val, double punt_val, double max_val, int opt_val) {
+        run[index] = run_val;
+        pass[index] = pass_val;
+        kick[index] = kick_val;
+        punt[index] = punt_val;
+        max[index] = max_val;
+        opt[index] = opt_val;
+        computed[index] = 1;
+    }
+
+    // Forget which states were written or entered, ahead of a fresh sweep
+    void reset_sweep() {
+        std::fill(computed.begin(), computed.end(), 0);
+        std::fill(visited.begin(), visited.end(), 0);
+    }
+};
+
+#endif
@@ -0,0 +1,93 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads that split a range of work items between them
+// Chunks are contiguous and assigned by thread number, so the same range always splits the same way
+class ThreadPool {
+public:
+    explicit ThreadPool(int num_threads) : num_threads(num_threads < 1 ? 1 : num_threads) {
+        // The calling thread takes chunk 0, so a pool of N only starts N-1 workers
+        for (int t = 1; t < this->num_threads; t++) {
+            workers.emplace_back([this, t] { worker_loop(t); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        start_cv.notify_all();
+        for (auto& worker : workers) worker.join();
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    int size() const { return num_threads; }
+
+    // Calls fn(begin, end) on every thread over its share of [0, count), returns once all have finished
+    void parallel_for(int count, const std::function<void(int, int)>& fn) {
+        if (num_threads == 1) {
+            fn(0, count);
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            job = &fn;
+            job_count = count;
+            pending = num_threads - 1;
+            generation++;
+        }
+        start_cv.notify_all();
+
+        run_chunk(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done_cv.wait(lock, [this] { return pending == 0; });
+        job = nullptr;
+    }
+
+private:
+    int num_threads;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable start_cv;
+    std::condition_variable done_cv;
+    const std::function<void(int, int)>* job = nullptr;
+    int job_count = 0;
+    int pending = 0;
+    unsigned long generation = 0;
+    bool stopping = false;
+
+    void run_chunk(int t) {
+        int begin = (long long)job_count * t / num_threads;
+        int end = (long long)job_count * (t + 1) / num_threads;
+        if (begin < end) (*job)(begin, end);
+    }
+
+    void worker_loop(int t) {
+        unsigned long seen = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                start_cv.wait(lock, [this, seen] { return stopping || generation != seen; });
+                if (stopping) return;
+                seen = generation;
+            }
+
+            run_chunk(t);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--pending == 0) done_cv.notify_one();
+        }
+    }
+};
+
+#endif
@@ -3,12 +3,14 @@
 # Flags
 QUIET_MODE=false
 FETCH_DATA=false
+CACHE_FLAG="--cache ep_data/cache"  # finished tables reused when inputs and parameters match (-f to re-solve)
 
 # Parse optional flags
 while [[ "$1" == -* ]]; do
     case "$1" in
         -q) QUIET_MODE=true ;;
         -d) FETCH_DATA=true ;;
+        -f) CACHE_FLAG="" ;;
         *) echo "Unknown flag: $1"; exit 1 ;;
     esac
     shift
@@ -20,13 +22,20 @@ if [ "$#" -eq 0 ]; then
 elif [ "$#" -eq 1 ]; then
     arg0=$1
 else
-    echo "Usage: $0 [-q] [-d] [arg0]"
+    echo "Usage: $0 [-q] [-d] [-f] [arg0]"
     echo "-q: Quiet mode"
     echo "-d: Fetch/refresh data before simulation"
+    echo "-f: Re-solve even if ep_data/cache has the table"
     echo "arg0: minimum elements per bin (default: 10)"
     exit 1
 fi
 
+# Simulators draw a progress line on stderr in quiet mode
+PROGRESS_FLAG=""
+if [ "$QUIET_MODE" = true ]; then
+    PROGRESS_FLAG="--progress"
+fi
+
 # Function to run a command with progress display
 run_command() {
     local cmd="$1"
@@ -39,11 +48,8 @@ run_command() {
     START_TIME=$(date +%s)
 
     if [ "$QUIET_MODE" = true ]; then
-        eval "$cmd" 2>&1 | while read -r line; do
-            if [[ "$line" =~ ^[0-9] ]]; then
-                echo -ne "\r$line  "
-            fi
-        done
+        # Simulators draw their own progress line on stderr (--progress), everything else is hidden
+        eval "$cmd" > /dev/null
         END_TIME=$(date +%s)
         echo -ne "\r$desc completed in $RUNTIME seconds.\n"
     else
@@ -54,14 +60,19 @@ run_command() {
 # Optionally fetch data
 if [ "$FETCH_DATA" = true ]; then
     run_command "Rscript rscripts/data.R \"$arg0\"" "Processing data"
-    run_command "Rscript rscripts/cdf.R \"$arg0\"" "Generating CDFs"
+    run_command "./executables/cdf_build.out distr_data cdf_data/cdf_bundle.bin \"$arg0\" --json cdf_data" "Generating CDFs"
+fi
+
+# Pack the CDF JSON into the binary bundle the simulators map at startup (only when the JSON is newer)
+if [ ! -f cdf_data/cdf_bundle.bin ] || [ -n "$(find cdf_data -name '*.json' -newer cdf_data/cdf_bundle.bin)" ]; then
+    run_command "./executables/cdf_pack.out cdf_data cdf_data/cdf_bundle.bin" "Packing CDFs"
 fi
 
 # Create output directory
 mkdir -p ep_data/biased_eps
 
 # Run naive simulation (hardcoded executable + inputs)
-run_command "./executables/simulator_naive.out ep_data/biased_eps/naive_eps.csv cdf_data" "Running naive simulation (epoch 0)"
+run_command "./executables/simulator_naive.out ep_data/biased_eps/naive_eps.csv cdf_data/cdf_bundle.bin $PROGRESS_FLAG $CACHE_FLAG" "Running naive simulation (epoch 0)"
 
 # Confirm output
 if [ -f ep_data/norm_eps/naive_eps.csv ]; then
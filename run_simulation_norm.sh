@@ -3,12 +3,20 @@
 # Flags
 QUIET_MODE=false
 FETCH_DATA=false
+TOLERANCE=0.0001
+SOLVE_FLAG=""
+ACCEL_FLAG=""
+CACHE_FLAG="--cache ep_data/cache"  # finished tables reused when inputs and parameters match (-f to re-solve)
 
 # Parse optional flags
 while [[ "$1" == -* ]]; do
     case "$1" in
         -q) QUIET_MODE=true ;;
         -d) FETCH_DATA=true ;;
+        -f) CACHE_FLAG="" ;;
+        -t) TOLERANCE=$2; shift ;;
+        -s) SOLVE_FLAG="--solve" ;;
+        -a) ACCEL_FLAG="--anderson $2"; shift ;;
         *) echo "Unknown flag: $1"; exit 1 ;;
     esac
     shift
@@ -18,21 +26,21 @@ done
 if [ "$FETCH_DATA" = true ]; then
     if [ "$#" -eq 0 ]; then
         arg0=20
-        iterations=3
+        iterations=100
     elif [ "$#" -eq 1 ]; then
         arg0=$1
-        iterations=3
+        iterations=100
     elif [ "$#" -eq 2 ]; then
         arg0=$1
         iterations=$2
     else
-        echo "Usage: $0 [-q] [-d] [arg0] [iterations]"
+        echo "Usage: $0 [-q] [-d] [-f] [-t tolerance] [-s] [-a anderson_depth] [arg0] [iterations]"
         exit 1
     fi
 else
     if [ "$#" -eq 0 ]; then
         arg0=20
-        iterations=3
+        iterations=100
     elif [ "$#" -eq 1 ]; then
         arg0=20
         iterations=$1
@@ -40,11 +48,17 @@ else
         arg0=$1
         iterations=$2
     else
-        echo "Usage: $0 [-q] [arg0] [iterations]"
+        echo "Usage: $0 [-q] [-f] [-t tolerance] [-s] [-a anderson_depth] [arg0] [iterations]"
         exit 1
     fi
 fi
 
+# Simulators draw a progress line on stderr in quiet mode
+PROGRESS_FLAG=""
+if [ "$QUIET_MODE" = true ]; then
+    PROGRESS_FLAG="--progress"
+fi
+
 # Function to run a command with progress display
 run_command() {
     local cmd="$1"
@@ -57,11 +71,8 @@ run_command() {
     START_TIME=$(date +%s)
 
     if [ "$QUIET_MODE" = true ]; then
-        eval "$cmd" 2>&1 | while read -r line; do
-            if [[ "$line" =~ ^[0-9] ]]; then
-                echo -ne "\r$line  "
-            fi
-        done
+        # Simulators draw their own progress line on stderr (--progress), everything else is hidden
+        eval "$cmd" > /dev/null
         END_TIME=$(date +%s)
         RUNTIME=$((END_TIME - START_TIME))
         echo -ne "\r$desc completed in $RUNTIME seconds.\n"
@@ -73,7 +84,12 @@ run_command() {
 # Optionally retrieve data
 if [ "$FETCH_DATA" = true ]; then
     run_command "Rscript data.R \"$arg0\"" "Processing data"
-    run_command "Rscript cdf.R \"$arg0\"" "Generating CDFs"
+    run_command "./executables/cdf_build.out distr_data cdf_data/cdf_bundle.bin \"$arg0\" --json cdf_data" "Generating CDFs"
+fi
+
+# Pack the CDF JSON into the binary bundle the simulators map at startup (only when the JSON is newer)
+if [ ! -f cdf_data/cdf_bundle.bin ] || [ -n "$(find cdf_data -name '*.json' -newer cdf_data/cdf_bundle.bin)" ]; then
+    run_command "./executables/cdf_pack.out cdf_data cdf_data/cdf_bundle.bin" "Packing CDFs"
 fi
 
 # Ensure the naive output file exists
@@ -82,20 +98,13 @@ if [ ! -f ep_data/norm_eps/naive_eps.csv ]; then
     exit 1
 fi
 
-# Copy naive eps.csv to temp
-cp ep_data/norm_eps/naive_eps.csv ep_data/norm_eps/temp_eps.csv
-
-# Run iterative simulation
-for ((i=1; i<iterations; i++)); do
-    run_command "./executables/simulator_norm.out ep_data/norm_eps/temp_eps.csv ep_data/norm_eps/temp_eps.csv aux_data/punt_net_yards.json cdf_data aux_data/nfl_fallback_counts.csv" "Running epoch $i"
-done
-
-# Final simulation
-run_command "./executables/simulator_norm.out ep_data/norm_eps/temp_eps.csv ep_data/norm_eps/final_eps.csv  aux_data/punt_net_yards.json cdf_data aux_data/nfl_fallback_counts.csv" "Running final epoch ($iterations)"
+# Run the epochs in one process: stops once prior EPs move less than the tolerance, or after $iterations epochs
+# (per-epoch residuals go to convergence.csv next to the EPs)
+run_command "./executables/simulator_norm.out ep_data/norm_eps/naive_eps.csv ep_data/norm_eps/final_eps.csv aux_data/punt_net_yards.json cdf_data/cdf_bundle.bin aux_data/nfl_fallback_counts.csv $TOLERANCE $iterations $SOLVE_FLAG $ACCEL_FLAG $PROGRESS_FLAG $CACHE_FLAG --report ep_data/norm_eps/convergence.csv" "Running simulation (up to $iterations epochs)"
 
 # Final check
 if [ -f ep_data/norm_eps/final_eps.csv ]; then
-    echo "Simulation completed successfully after $iterations iterations."
+    echo "Simulation completed successfully."
 else
     echo "Error: Final simulation did not produce eps.csv"
     exit 1
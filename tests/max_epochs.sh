@@ -0,0 +1,55 @@
+#!/bin/bash
+
+# Stops the epoch simulators at max_epochs before they converge and checks that every state is still saved, with
+# its EPs (a run that ran out of epochs once saved an empty table, and before that one with every EP at 0)
+# Usage, from the repo root after ./build.sh: tests/max_epochs.sh [executables dir, default executables] [max distance, default 20]
+
+BIN=${1:-executables}
+MAX_DISTANCE=${2:-20}
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+# One row per (down, distance, yardline) with distance <= min(yardline, MAX_DISTANCE), plus the header
+EXPECTED=1
+for ((yardline=1; yardline<100; yardline++)); do
+    EXPECTED=$((EXPECTED + 4 * (yardline < MAX_DISTANCE ? yardline : MAX_DISTANCE)))
+done
+
+FAILED=0
+
+# check NAME FILE: every state written, and not every EP 0
+check() {
+    local rows nonzero
+    rows=$(wc -l < "$2")
+    nonzero=$(awk -F, 'NR > 1 && $8 != 0' "$2" | wc -l)
+    if [ "$rows" -ne "$EXPECTED" ] || [ "$nonzero" -eq 0 ]; then
+        echo "FAIL $1: $rows rows (expected $EXPECTED), $nonzero non-zero EPs"
+        FAILED=1
+    else
+        echo "ok   $1"
+    fi
+}
+
+NORM="aux_data/punt_net_yards.json cdf_data aux_data/nfl_fallback_counts.csv"
+SIM="aux_data/punt_net_yards.json cdf_data"
+
+# A tolerance of 0 is never reached, so every run below stops at max_epochs
+"$BIN/simulator_norm.out" ep_data/norm_eps/naive_eps.csv "$TMP/norm_1.csv" $NORM 0 1 > /dev/null
+check "simulator_norm, 1 epoch" "$TMP/norm_1.csv"
+"$BIN/simulator_norm.out" ep_data/norm_eps/naive_eps.csv "$TMP/norm_5.csv" $NORM 0 5 > /dev/null
+check "simulator_norm, 5 epochs" "$TMP/norm_5.csv"
+"$BIN/simulator_norm.out" ep_data/norm_eps/naive_eps.csv "$TMP/norm_anderson.csv" $NORM 0 5 --anderson 3 > /dev/null
+check "simulator_norm, 5 epochs with --anderson 3" "$TMP/norm_anderson.csv"
+
+# The second run is a cache hit, so it checks the stored table
+"$BIN/simulator_norm.out" ep_data/norm_eps/naive_eps.csv "$TMP/norm_store.csv" $NORM 0 3 --cache "$TMP/cache" > /dev/null
+"$BIN/simulator_norm.out" ep_data/norm_eps/naive_eps.csv "$TMP/norm_fetch.csv" $NORM 0 3 --cache "$TMP/cache" > /dev/null
+check "simulator_norm, 3 epochs from the cache" "$TMP/norm_fetch.csv"
+
+"$BIN/simulator.out" ep_data/biased_eps/naive_eps.csv "$TMP/sim_3.csv" $SIM 0 3 > /dev/null
+check "simulator, 3 epochs" "$TMP/sim_3.csv"
+"$BIN/simulator.out" ep_data/biased_eps/naive_eps.csv "$TMP/sim_cold.csv" $SIM 0 3 --cold-sweeps > /dev/null
+check "simulator, 3 epochs with --cold-sweeps" "$TMP/sim_cold.csv"
+
+exit $FAILED